@@ -0,0 +1,96 @@
+#ifndef ARM_CONFIG_H
+#define ARM_CONFIG_H
+
+#include <stdint.h>
+
+// --- ROBOT DIMENSIONS (cm) ---
+const float L1 = 7.55;  // Base Height
+const float L2 = 9.01;  // Shoulder Length
+const float L3 = 9.005; // Elbow Length
+const float L4 = 3.25;  // Gripper Length
+
+// --- SERVO LIMITS & KINEMATICS DATA ---
+struct ServoConfig
+{
+    uint8_t pin;
+    int minUs;
+    int maxUs;
+    int startUs;
+    float angle0;   // Angle when slider is at 0% (linear model, see tools/fit_servo_cal.py)
+    float angle100; // Angle when slider is at 100%
+    const char *name;
+    // Motion profile of the output stage, 0 = step instantly
+    float maxVelUsS;  // Pulse width rate limit (us/s)
+    float maxAccUsS2; // Pulse width acceleration limit (us/s^2)
+};
+
+// Index: 0=Base, 1=Shoulder, 2=Elbow, 3=Wrist, 4=Gripper
+const int NUM_SERVOS = 5;
+
+// Compile time table: lives in flash, folds into the code that reads it,
+// and is checked below before anything runs.
+// Profile limits: ~180 deg/s, the shoulder carries the whole arm and ramps
+// slower
+constexpr ServoConfig servos[NUM_SERVOS] = {
+    // Base: 0%=Left(85), 100%=Right(-65)
+    {11, 500, 2500, 1500, 85.0, -65.8, "Base", 2500, 15000},
+
+    // Shoulder: SWAPPED ANGLES to fix "Wrong Way Round"
+    // If 0% on slider makes the arm go BACK/UP, then 0% = 180 degrees.
+    // If 100% on slider makes the arm go FLAT/FORWARD, then 100% = 0 degrees.
+    {12, 500, 2200, 600, 180.0, 0.0, "Shoulder", 2000, 10000},
+
+    // Elbow: 0%=Straight(172), 100%=Bent(24)
+    {13, 500, 2500, 2400, 172.0, 24.34, "Elbow", 2500, 15000},
+
+    // Wrist: 0%=Down(94), 100%=Up(230)
+    {14, 500, 2500, 1500, 94.5, 230.3, "Wrist", 3000, 20000},
+
+    // Gripper
+    {15, 600, 1500, 600, 0, 0, "Gripper", 3000, 30000}};
+
+// --- SANITY CHECKS ---
+// Servo frame of the PCA9685 at 50Hz
+const int SERVO_FRAME_US = 20000;
+
+constexpr bool servoPinsValid()
+{
+    for (int i = 0; i < NUM_SERVOS; i++)
+    {
+        if (servos[i].pin > 15)
+            return false;
+        for (int j = i + 1; j < NUM_SERVOS; j++)
+            if (servos[i].pin == servos[j].pin)
+                return false;
+    }
+    return true;
+}
+
+constexpr bool servoRangesValid()
+{
+    for (int i = 0; i < NUM_SERVOS; i++)
+    {
+        const ServoConfig &s = servos[i];
+        // processLine() tells us rows from percent rows by every value > 100
+        if (s.minUs <= 100 || s.minUs >= s.maxUs || s.maxUs >= SERVO_FRAME_US)
+            return false;
+        if (s.startUs < s.minUs || s.startUs > s.maxUs)
+            return false;
+        if (s.maxVelUsS < 0 || s.maxAccUsS2 < 0)
+            return false;
+    }
+    return true;
+}
+
+constexpr int servoMaxUs()
+{
+    int m = 0;
+    for (int i = 0; i < NUM_SERVOS; i++)
+        m = servos[i].maxUs > m ? servos[i].maxUs : m;
+    return m;
+}
+
+static_assert(servoPinsValid(), "servos[]: pins must be unique PCA9685 channels 0-15");
+static_assert(servoRangesValid(), "servos[]: need 100 < minUs < maxUs < 20000, startUs inside, limits >= 0");
+
+#endif
@@ -0,0 +1,171 @@
+#ifndef ARM_CONTROL_H
+#define ARM_CONTROL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "kinematics.h"
+#include "recording.h"
+
+// ================= CONTROL CORE =================
+// Platform independent: servo output, recording, playback and the script
+// runner. Inputs (ESP-NOW packets, HTTP commands) arrive through the
+// functions below, hardware is reached through hal.h.
+
+// --- MODES ---
+enum ControlMode
+{
+    MODE_CONTROLLER = 0,
+    MODE_WEB = 1,
+    MODE_SCRIPT = 2
+};
+
+// Playback follows the recorded time either way (true speed whatever the
+// controller rate was); per frame it outputs
+enum PlaybackMode
+{
+    PLAYBACK_HOLD = 0,       // the last row that is due, rows as recorded
+    PLAYBACK_INTERPOLATE = 1 // the trajectory resampled at the frame time
+};
+
+struct ScriptState
+{
+    bool active;
+    int scriptId;
+    int step;
+    unsigned long lastStepTime;
+};
+
+// --- DATA STRUCTURES ---
+// INCOMING ESP-NOW Message matching the Controller
+typedef struct struct_message
+{
+    uint8_t base;     // 0-100
+    uint8_t shoulder; // 0-100
+    uint8_t elbow;    // 0-100
+    uint8_t wrist;    // 0-100
+    bool grabber;     // 0 or 1
+} struct_message;
+
+// --- SHARED STATE ---
+extern Recording recordingBuffer; // Encoded, see recording.h
+extern bool isRecording;
+extern bool isPlaying;
+extern size_t playStep; // Rows played
+extern int playbackMode; // PLAYBACK_*
+extern bool ikReachable;
+extern float ikErrorCm; // Tip error of the last IK target (0 if reached exactly)
+extern int currentMode;
+extern ScriptState scriptRunner;
+extern int currentUs[NUM_SERVOS]; // Commanded pulses (us), only written by moveServoUs
+extern int outputUs[NUM_SERVOS];  // Pulses on the wire, trail currentUs by the profile
+extern uint8_t profileBypassMask; // Joints whose commands are planned upstream (joint_motion.h, cartesian_motion.h)
+extern bool motionProfileEnabled; // false: outputs step to the command (bring-up, host tests)
+extern volatile uint32_t jointVersion; // Bumped by moveServoUs whenever currentUs changes
+
+// --- OUTPUT ---
+// moveServoUs() only sets the command. commitServoFrame() moves every joint
+// towards its command under the maxVelUsS/maxAccUsS2 profile of its
+// ServoConfig (trapezoidal, so no command source steps a servo), then puts
+// the channels whose tick changed since the last write on the bus at once,
+// consecutive channels (11-15) in one burst, so the joints of a frame update
+// together. controlTick() commits.
+struct FrameStats
+{
+    uint32_t frames;         // Frames that put something on the bus
+    uint32_t lastBusUs;      // Bus time of the last frame
+    uint32_t maxBusUs;
+    uint32_t writes;         // Channel writes issued
+    uint32_t suppressed;     // Staged channel writes skipped (tick unchanged)
+    uint32_t lost;           // Channel writes lost on the bus, sent again next frame
+};
+extern FrameStats frameStats;
+
+int usToTicks(int microseconds); // Table lookup, clamped to 0..servoMaxUs()
+void moveServoUs(int servoIndex, int us);     // Clamped to minUs..maxUs
+void moveServo(int servoIndex, int percent);  // UI convenience (0-100)
+int servoPercent(int servoIndex);             // currentUs as percent, for the UI
+void homeServos(); // Drive every servo to its startUs (commits right away, unprofiled)
+bool servosSettled(uint8_t mask = 0x1F); // Every output in mask has reached its command (or has no profile)
+// Joints in mask still moving on the profile are commanded to where they
+// can stop (braking at maxAccUsS2). Once servosSettled(mask), a planned
+// move can start at currentUs without a jump. Returns servosSettled(mask).
+bool settleServos(uint8_t mask);
+uint32_t commitServoFrame(); // Returns bus time (us), 0 if nothing changed
+
+// --- FRAME LOCK ---
+// The PCA9685 starts every pulse when its frame counter wraps. A value
+// written just after that waits a whole frame, one written mid-pulse can
+// stretch the pulse. So the 50Hz work (playback, Cartesian interpolation)
+// runs in one slot per frame, FRAME_LEAD_US before the next frame starts
+// by halFrameClock(), and its commit is on the wire for the very next
+// pulse. Every FRAME_RESYNC_FRAMES slots the PCA9685 counter is restarted
+// right after the commit, so what is left of the oscillator error never
+// adds up to more than a second's worth. The restart only starts if it can
+// finish (halFrameRestartUs() plus FRAME_RESTART_SLACK_US) before the
+// frame does; the control task waits out the oscillator start-up in the
+// middle of it without the control lock.
+const uint32_t FRAME_LEAD_US = 2000;
+const uint32_t FRAME_RESYNC_FRAMES = 50;
+const uint32_t FRAME_RESTART_SLACK_US = 200; // Wake-up and lock wait of the second half
+
+struct FrameLockStats
+{
+    uint32_t slots;   // Slots run
+    uint32_t missed;  // Slots skipped because the tick came too late
+    uint32_t resyncs; // Counter restarts
+};
+extern FrameLockStats frameLock;
+
+// Start of the next slot on the halMicros() timeline (the control task
+// sleeps until then)
+uint32_t nextFrameSlotUs();
+// true while controlTick() left a counter restart halfway; the control task
+// calls finishFrameRestart() at restartUs (controlTick() does too, once due)
+bool frameRestartPending(uint32_t &restartUs);
+void finishFrameRestart();
+
+// --- KINEMATICS ON THE LIVE JOINT STATE ---
+// Pose of currentUs. Cached, only recomputed when jointVersion changed.
+Coord calculateFK();
+// Last pose calculateFK() produced, never recomputes. Safe to call from
+// another task than the one driving the servos.
+Coord cachedFK();
+// Moves to the target, or to the nearest reachable pose (see IkProjection)
+IkProjection calculateIK(float x, float y, float z, float pitch_deg, bool relaxPitch = false);
+
+// --- INPUTS ---
+// ESP-NOW packets: the WiFi callback stamps each with its arrival time and
+// queues it (lock-free, constant time, one producer); controlTick()
+// applies them in order. A full queue drops the packet.
+const size_t CONTROLLER_QUEUE_LEN = 16; // ~320 ms of packets at 50 Hz
+struct ControllerQueueStats
+{
+    uint32_t received; // Queued (WiFi task)
+    uint32_t dropped;  // Queue full (WiFi task)
+    uint32_t maxDepth; // Most packets drained in one tick (control task)
+};
+extern ControllerQueueStats controllerQueueStats;
+bool queueControllerInput(const struct_message &msg, uint32_t timeMs);
+void applyControllerInput(const struct_message &msg, uint32_t timeMs); // Control task
+void setControlMode(int mode);
+void startScript(int id);
+
+// --- RECORDING ---
+void startRecording();
+void startSlotRecording(); // Into the slot opened with slotRecordOpen()
+void stopRecording();
+void startPlayback();
+void startSlotPlayback(); // The slot opened with slotPlayOpen(), from flash
+void clearRecording();
+void recordStep(const RecordedStep &step, uint32_t timeMs); // Appends, stops recording when full
+// One CSV row (us or percent, optional Time_ms column) -> recordingBuffer
+void processLine(const char *line);
+void loadRecordingCsv(const char *csv); // Whole CSV text (demos)
+
+// --- CONTROL LOOP ---
+// Playback + script runner + frame commit. The control task calls it once
+// per frame slot; calling it more often (host tests) only adds commits.
+void controlTick();
+
+#endif
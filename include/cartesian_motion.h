@@ -0,0 +1,98 @@
+#ifndef CARTESIAN_MOTION_H
+#define CARTESIAN_MOTION_H
+
+#include <stdint.h>
+#include "kinematics.h"
+
+// ================= CARTESIAN MOTION =================
+// Tool-tip motion that is interpolated in Cartesian space by the control
+// loop, so the HTTP request rate no longer decides how smooth a move is.
+// While a line or jog runs the output profile passes the arm joints
+// through (profileBypassMask): braking at every step would make each joint
+// lag by its own amount and pull the tip off the line.
+
+// Base, shoulder, elbow and wrist: the joints a line or jog plans
+const uint8_t CARTESIAN_JOINTS = 0x0F;
+
+// Nominal control period for Cartesian interpolation: it runs in the frame
+// slot like playback (arm_control.h), once per PCA9685 frame
+const unsigned long CARTESIAN_PERIOD_MS = 20;
+// Time budget for one IK solve inside a control tick. A MOVEL whose solves
+// overrun it solves on fewer frames (LinearMove::stride) until they fit.
+const uint32_t CARTESIAN_IK_BUDGET_US = 1000;
+
+// --- MOVEL (straight line) ---
+struct LinearMove
+{
+    bool active;
+    Coord start;
+    Coord target;
+    float durationMs;
+    float rampMs;         // Acceleration (= braking) phase, see timeScaling()
+    unsigned long startTime;
+    unsigned long lastTick;
+    uint32_t lastSolveUs; // IK time of the last tick
+    uint32_t maxSolveUs;
+    uint32_t overruns;    // Ticks whose IK exceeded CARTESIAN_IK_BUDGET_US
+    uint8_t stride;       // Frames per IK solve, 1 unless solves overrun
+    uint8_t waited;       // Frames since the last solve
+    bool waiting;         // Joints still braking from earlier commands, not started yet
+};
+extern LinearMove linearMove;
+extern float linearSpeedCmS; // Tip speed for MOVEL
+
+// --- JOG (velocity mode) ---
+// Tip velocity mapped to joint rates through the FK Jacobian every control
+// period. Damped least squares keeps the rates bounded near singularities
+// (tip over the base axis, arm stretched out).
+struct JogState
+{
+    bool active;
+    float velocity[4];     // cm/s x, y, z and deg/s pitch
+    float angle[4];        // Integrated joint angles (deg), finer than 1 us
+    int commanded[4];      // Pulses (us) last sent, to detect outside moves
+    unsigned long endTime; // 0 = until stopped
+    unsigned long lastTick;
+    float manipulability;  // |det J| of the last tick
+    float damping;         // lambda of the last tick
+    uint8_t limitMask;     // Joints held at a servo limit in the last tick
+};
+extern JogState jog;
+
+// Starts or updates a jog. durationMs = 0 runs until stopCartesianMotion().
+void startJog(float vx, float vy, float vz, float vpitch, unsigned long durationMs = 0);
+
+// Starts a straight line from the current FK pose to the target, or to the
+// nearest reachable pose if the target is out of reach. The line is checked
+// against the IK grid first: one that leaves the workspace is not started
+// (linearMove.active stays false, errorCm is how far it leaves). The line
+// runs on a trapezoidal time scaling, stretched until no joint exceeds its
+// maxVelUsS/maxAccUsS2, so it can take longer than linearSpeedCmS says.
+IkProjection startLinearMove(float x, float y, float z, float pitch_deg, bool relaxPitch = false);
+
+// startLinearMove() in two halves, so the planning (up to LINE_CHECK_POINTS
+// grid lookups and the exact IK along the line) stays out of the control
+// lock: planLinearMove() only reads its arguments and runs on a copy of
+// currentUs, startPlannedLinearMove() starts the line under the lock. It
+// returns false if the plan is blocked or the joints left plan.from since.
+// Take from after settleServos(CARTESIAN_JOINTS): the line then starts
+// once the joints rest there (linearMove.waiting until then).
+struct LinePlan
+{
+    int from[4];       // Joint state (us) the line starts at
+    Coord start;
+    Coord target;
+    float durationMs;
+    float rampMs;
+    IkProjection proj; // Target mapping; errorCm is how far a blocked line leaves
+    bool blocked;      // Leaves the workspace, not started
+};
+void planLinearMove(const int *from, float x, float y, float z, float pitch_deg, bool relaxPitch, float speedCmS,
+                    LinePlan &plan);
+bool startPlannedLinearMove(const LinePlan &plan);
+void stopCartesianMotion();
+
+// Called from controlTick(), interpolates when frameDue (the frame slot)
+void cartesianMotionTick(bool frameDue);
+
+#endif
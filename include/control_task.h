@@ -0,0 +1,46 @@
+#ifndef CONTROL_TASK_H
+#define CONTROL_TASK_H
+
+#include <stdint.h>
+
+// ================= CONTROL TASK =================
+// controlTick() runs in its own FreeRTOS task pinned to core 1, once per
+// PCA9685 frame: an esp_timer wakes it at the frame slot (nextFrameSlotUs(),
+// FRAME_LEAD_US before the next pulse), so the tick is phase-locked to the
+// driver instead of beating against it. Networking (WiFi, HTTP, ESP-NOW)
+// stays on core 0. Anything on core 0 that touches the control core
+// (arm_control.h, cartesian_motion.h) holds the control lock, e.g. with a
+// ControlGuard. The ESP-NOW callback doesn't: it only queues the packet
+// (queueControllerInput()), so the WiFi task never waits on a tick.
+
+const int CONTROL_TASK_CORE = 1;
+const int CONTROL_TASK_PRIORITY = 5;
+
+struct ControlTiming
+{
+    uint32_t ticks;
+    uint32_t lastJitterUs; // Wake-up delay against the frame slot
+    uint32_t maxJitterUs;
+    uint32_t lastRunUs;    // controlTick() time, lock wait included
+    uint32_t maxRunUs;
+    uint32_t overruns;     // Ticks that ended after their frame started
+};
+extern ControlTiming controlTiming;
+
+// Call once from setup(), after homeServos()
+void startControlTask();
+void resetControlTiming();
+
+void controlLock();
+void controlUnlock();
+
+class ControlGuard
+{
+public:
+    ControlGuard() { controlLock(); }
+    ~ControlGuard() { controlUnlock(); }
+    ControlGuard(const ControlGuard &) = delete;
+    ControlGuard &operator=(const ControlGuard &) = delete;
+};
+
+#endif
@@ -1,6 +1,10 @@
 #ifndef DEMOS_H
 #define DEMOS_H
+#ifdef ARDUINO
 #include <Arduino.h>
+#else
+#define PROGMEM
+#endif
 
 const char demo_picknplace[] PROGMEM = R"rawliteral(
 Base,Shoulder,Elbow,Wrist,Gripper
@@ -0,0 +1,141 @@
+#ifndef FAST_MATH_H
+#define FAST_MATH_H
+
+#include <math.h>
+
+// ================= SINGLE PRECISION MATH =================
+// The ESP32 FPU only does single precision. cos()/sin()/atan2()/acos() are
+// double and end up in soft-float, polySinCos()/polyAtan2()/polyAcos() stay
+// in float.
+//
+// Error bounds (measured over the full input range, before float rounding):
+//   polySinCos : |err| < 3.2e-7
+//   polyAtan2  : |err| < 1.7e-6 rad (~1e-4 deg)
+//   polyAcos   : |err| < 1.7e-6 rad
+// That is far below one percent of any joint range (>= 1.36 deg).
+//
+// The kinematics call fastSinCos()/fastAtan2()/fastAcos(), the float
+// polynomials. -DKINEMATICS_DOUBLE_TRIG switches them back to the double
+// libm functions, e.g. to compare on /bench_kinematics.
+
+const float PI_F = 3.14159265f;
+const float HALF_PI_F = 1.57079633f;
+const float DEG_TO_RAD_F = 0.0174532925f;
+const float RAD_TO_DEG_F = 57.2957795f;
+
+// sin and cos of the same angle in one range reduction
+inline void polySinCos(float x, float &s, float &c)
+{
+    // Reduce to r in [-pi/4, pi/4] and quadrant q
+    float qf = x * (2.0f / PI_F);
+    qf = qf >= 0.0f ? (float)(int)(qf + 0.5f) : (float)(int)(qf - 0.5f);
+    int q = (int)qf;
+    // Two step Cody-Waite reduction keeps r accurate for |x| up to a few turns
+    float r = (x - qf * 1.5703125f) - qf * 4.83826794e-4f;
+    float r2 = r * r;
+
+    // Taylor polynomials, truncation error at |r| = pi/4 below 3.2e-7
+    float sr = r * (1.0f + r2 * (-1.66666667e-1f + r2 * (8.33333333e-3f + r2 * -1.98412698e-4f)));
+    float cr = 1.0f + r2 * (-0.5f + r2 * (4.16666667e-2f + r2 * (-1.38888889e-3f + r2 * 2.48015873e-5f)));
+
+    switch (q & 3)
+    {
+    case 0:
+        s = sr;
+        c = cr;
+        break;
+    case 1:
+        s = cr;
+        c = -sr;
+        break;
+    case 2:
+        s = -sr;
+        c = -cr;
+        break;
+    default:
+        s = -cr;
+        c = sr;
+        break;
+    }
+}
+
+inline float polyAtan2(float y, float x)
+{
+    float ax = fabsf(x);
+    float ay = fabsf(y);
+    if (ax == 0.0f && ay == 0.0f)
+        return 0.0f;
+
+    // atan on [0, 1], minimax polynomial
+    bool swap = ay > ax;
+    float t = swap ? ax / ay : ay / ax;
+    float t2 = t * t;
+    float a = t * (0.99997726f + t2 * (-0.33262347f + t2 * (0.19354346f + t2 * (-0.11643287f + t2 * (0.05265332f + t2 * -0.01172120f)))));
+
+    if (swap)
+        a = HALF_PI_F - a;
+    if (x < 0.0f)
+        a = PI_F - a;
+    return y < 0.0f ? -a : a;
+}
+
+// Input is clamped to [-1, 1]
+inline float polyAcos(float x)
+{
+    if (x > 1.0f)
+        x = 1.0f;
+    if (x < -1.0f)
+        x = -1.0f;
+    return polyAtan2(sqrtf(1.0f - x * x), x);
+}
+
+// --- KINEMATICS TRIG ---
+#ifndef KINEMATICS_DOUBLE_TRIG
+inline void fastSinCos(float x, float &s, float &c)
+{
+    polySinCos(x, s, c);
+}
+
+inline float fastAtan2(float y, float x)
+{
+    return polyAtan2(y, x);
+}
+
+inline float fastAcos(float x)
+{
+    return polyAcos(x);
+}
+#else
+inline void fastSinCos(float x, float &s, float &c)
+{
+    s = (float)sin((double)x);
+    c = (float)cos((double)x);
+}
+
+inline float fastAtan2(float y, float x)
+{
+    return (float)atan2((double)y, (double)x);
+}
+
+// Input is clamped to [-1, 1]
+inline float fastAcos(float x)
+{
+    return (float)acos(x > 1.0f ? 1.0 : (x < -1.0f ? -1.0 : (double)x));
+}
+#endif
+
+inline float fastSin(float x)
+{
+    float s, c;
+    fastSinCos(x, s, c);
+    return s;
+}
+
+inline float fastCos(float x)
+{
+    float s, c;
+    fastSinCos(x, s, c);
+    return c;
+}
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef HAL_H
+#define HAL_H
+
+#include <stdint.h>
+
+// ================= HARDWARE ABSTRACTION =================
+// The control core (kinematics, recording, playback, scripts) only reaches
+// the hardware through these functions.
+//   src/hal_esp32.cpp   -> PCA9685 over I2C, Arduino millis()/micros()
+//   src/native/         -> simulated PCA9685 + simulated clock (host builds)
+
+// Bring up the servo driver (I2C + PCA9685 @ 50Hz). The bus runs at the
+// fastest of HAL_I2C_CLOCKS that passes a register read-back self-test.
+void halBegin();
+
+// --- TIME SOURCE ---
+uint32_t halMillis();
+uint32_t halMicros();
+// Free running CPU cycle counter, for benchmarks only
+uint32_t halCycles();
+
+// --- SERVO OUTPUT ---
+// Raw PCA9685 channel write, on/off in ticks (0-4095)
+void halSetPWM(uint8_t channel, uint16_t on, uint16_t off);
+// Writes channels first..first+count-1 (on = 0) in one auto-increment I2C
+// transaction; the PCA9685 latches them together on the STOP condition.
+// busUs receives the bus time in microseconds. false if the burst was lost
+// (NACK at the slowest clock): the channels still hold their old pulses.
+bool halWriteBurst(uint8_t firstChannel, const uint16_t *offTicks, uint8_t count, uint32_t &busUs);
+
+// --- PWM FRAME CLOCK ---
+// The PCA9685 counts its 50Hz frame on its own oscillator. Frame n starts
+// (all pulses go high) at originUs + n * periodNs / 1000 on the halMicros()
+// timeline. halBegin() and halRestartFrame() restart the counter and move
+// the origin there; periodNs follows from oscHz and the prescaler, so it is
+// only as good as the oscillator calibration.
+struct HalFrameClock
+{
+    uint32_t originUs;
+    uint32_t periodNs;
+    uint32_t oscHz;
+};
+HalFrameClock halFrameClock();
+
+// Datasheet value, real chips are off by a few percent
+const uint32_t HAL_PCA9685_OSC_HZ = 25000000;
+// Measured oscillator frequency (Hz, e.g. from the PWM period on a scope),
+// passed to setOscillatorFrequency(). Re-picks the prescaler and restarts
+// the frame. 0 = back to HAL_PCA9685_OSC_HZ.
+void halSetOscillator(uint32_t oscHz);
+// Keeps oscHz across resets for halBegin(). A flash write that can take
+// milliseconds, so not under the control lock.
+void halStoreOscillator(uint32_t oscHz);
+
+// Restarts the PCA9685 counter in two halves: halStopFrame() puts the chip
+// to sleep and wakes it again, halRestartFrame() no earlier than
+// HAL_PCA9685_STARTUP_US later starts a new frame there. The caller waits
+// in between. Only while all outputs are low (between the pulses), or a
+// pulse gets cut. halStopFrame() false = nothing written, skip the restart.
+const uint32_t HAL_PCA9685_STARTUP_US = 500; // Oscillator after wake-up
+bool halStopFrame();
+void halRestartFrame();
+// Both halves and the wait in between at the current I2C clock
+uint32_t halFrameRestartUs();
+
+// --- I2C BUS ---
+// Fastest first. A failed burst drops the clock one step and is retried.
+const uint32_t HAL_I2C_CLOCKS[] = {1000000, 400000, 100000};
+const int HAL_I2C_CLOCK_COUNT = 3;
+
+struct HalBusStatus
+{
+    uint32_t clockHz;
+    uint32_t errors;    // Failed transactions (NACK, read-back mismatch)
+    uint32_t fallbacks; // Clock steps taken down
+};
+HalBusStatus halBusStatus();
+
+// --- FILES ---
+// Flash filesystem: LittleFS on the ESP32 (formatted on first mount), a
+// temporary directory on the host. Blocking, so never from the control
+// task. Paths start with '/', handles are small ints, -1 = failed.
+const int HAL_FILE_MAX = 4; // Open at the same time
+bool halFileBegin();
+int halFileOpen(const char *path, const char *mode); // "r", "w" (creates dirs)
+int halFileRead(int file, uint8_t *buf, int len);     // 0 at the end
+int halFileWrite(int file, const uint8_t *buf, int len);
+void halFileSync(int file); // Written data survives a power cut from here
+void halFileClose(int file);
+bool halFileRemove(const char *path);
+// Calls onFile(name without dir, size, ctx) for every file in dir
+void halFileList(const char *dir, void (*onFile)(const char *name, uint32_t size, void *ctx), void *ctx);
+
+// --- DIAGNOSTICS ---
+void halLog(const char *msg);
+
+#endif
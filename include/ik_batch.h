@@ -0,0 +1,53 @@
+#ifndef IK_BATCH_H
+#define IK_BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "arm_control.h"
+
+// ================= BATCH IK =================
+// Solves a whole Cartesian path up front into a joint-space trajectory that
+// plays through the normal recording playback (one step per ~20ms).
+
+struct CartesianWaypoint
+{
+    float x;
+    float y;
+    float z;
+    float pitch;
+    uint8_t gripper; // 0-100
+};
+
+struct IkBatchResult
+{
+    size_t solved;         // Steps written to the trajectory
+    long firstUnreachable; // Index of the first unreachable waypoint, -1 if none
+    bool tooLong;          // More steps than the recording holds
+};
+
+// Solves points[0..count) into out (cleared first), stops at the first
+// unreachable point. reachable (optional, count entries) receives 1/0 per
+// point; points after an early stop are left at 0. The first point takes
+// the IK branch closest to from (us, index 0-3), currentUs if null.
+IkBatchResult solveIKBatch(const CartesianWaypoint *points, size_t count, std::vector<RecordedStep> &out,
+                           uint8_t *reachable = nullptr, const int *from = nullptr);
+
+// Reachability of every point without solving: the IK grid answers most of
+// them in O(1), the exact IK the rest. Index of the first unreachable point,
+// -1 if none.
+long checkCartesianPath(const CartesianWaypoint *points, size_t count);
+
+// Parses one "x,y,z,pitch[,gripper]" CSV row. Returns false for headers/garbage.
+bool parseWaypointLine(const char *line, CartesianWaypoint &wp);
+
+// Solves the whole path into out (cleared first). Touches no arm state, so
+// it runs without the control lock: from is a copy of currentUs. Only a
+// path with every point reachable (firstUnreachable < 0) that fits the
+// recording (!tooLong, solved = the steps that fit) is ready to play.
+IkBatchResult solvePathRecording(const CartesianWaypoint *points, size_t count, const int *from, Recording &out);
+
+// Replaces recordingBuffer by a solved path and plays it. Control lock held.
+void playSolvedPath(const Recording &path);
+
+#endif
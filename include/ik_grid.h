@@ -0,0 +1,29 @@
+#ifndef IK_GRID_H
+#define IK_GRID_H
+
+// ================= IK LOOKUP GRID =================
+// O(1) reachability and joint seeds from the flash-resident grid generated
+// by tools/gen_ik_grid.py (include/ik_grid_data.h) at build time.
+//
+// The grid holds both base branches (direct and over the top) and both
+// elbow branches, picked in the order inverseKinematics() tries them. A
+// target counts as reachable when all 8 grid nodes around it solve on the
+// same branch, inside the servo limits. That makes it a conservative filter:
+// near the workspace boundary, where a branch changes and outside pitch
+// -90..90 it says no to targets the exact IK reaches. A "no" is only final
+// after inverseKinematics(), ikGridReachableExact() does both.
+
+// Returns true if (x, y, z, pitch) lies inside the reachable grid region.
+// If seed is not null it receives interpolated joint pulses (us, index 0-3).
+bool ikGridLookup(float x, float y, float z, float pitch_deg, float *seed);
+
+inline bool ikGridReachable(float x, float y, float z, float pitch_deg)
+{
+    return ikGridLookup(x, y, z, pitch_deg, nullptr);
+}
+
+// Grid first, the exact IK only where the grid says no. seed as above, the
+// exact solution if the grid missed.
+bool ikGridReachableExact(float x, float y, float z, float pitch_deg, float *seed = nullptr);
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef JOINT_MOTION_H
+#define JOINT_MOTION_H
+
+#include <stdint.h>
+#include "kinematics.h"
+
+// ================= JOINT MOTION =================
+// Synchronized joint-space moves on top of moveServoUs(): every joint of a
+// move follows the same trapezoidal time scaling, stretched so the joint
+// that needs longest under its maxVelUsS/maxAccUsS2 sets the duration.
+// All joints start and arrive together and the tip path is repeatable.
+// The commands already respect the limits, so the output profile passes
+// the moving joints through (profileBypassMask). A joint still moving from
+// earlier commands brakes to a stop on the profile first (settleServos()),
+// the move starts from there once all its joints rest.
+
+struct JointMove
+{
+    bool active;
+    uint8_t mask;              // Joints taking part
+    float start[NUM_SERVOS];   // us
+    float delta[NUM_SERVOS];   // us
+    float durationMs;
+    float rampMs;              // Acceleration (= deceleration) phase
+    unsigned long startTime;
+    bool waiting;              // Joints still braking, not started yet
+};
+extern JointMove jointMove;
+
+// Moves the joints in mask to targetUs (clamped to the servo ranges),
+// speed scales the joint limits (0-1]. Returns the duration in ms, not
+// counting the braking of joints that were still moving.
+float startJointMove(const int *targetUs, uint8_t mask = 0x1F, float speed = 1.0f);
+// IK target as a synchronized joint move (nearest reachable pose, like
+// calculateIK())
+IkProjection startJointMoveToXYZ(float x, float y, float z, float pitch_deg, bool relaxPitch = false,
+                                 float speed = 1.0f);
+void stopJointMove();
+
+// Called from controlTick()
+void jointMotionTick();
+
+// Position 0..1 along a trapezoidal time scaling of durationMs after t ms,
+// rampMs accelerating and as long braking (MOVEL times its lines with it)
+float timeScaling(float t, float durationMs, float rampMs);
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef KEYFRAMES_H
+#define KEYFRAMES_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "recording.h"
+
+// ================= KEYFRAMES =================
+// Ramer-Douglas-Peucker in joint space: keeps only the rows the trajectory
+// can't be interpolated through within the tolerance on every joint. The
+// deviation is taken at the same time on the chord between two kept rows,
+// which is how PLAYBACK_INTERPOLATE plays them, so the dropped rows just
+// become the duration between keyframes.
+// Runs over windows of KEYFRAME_WINDOW rows (the window ends are always
+// kept), so the work memory stays small for a full recording buffer.
+
+enum KeyframeUnit
+{
+    KEYFRAME_PERCENT = 0, // Of each servo's minUs..maxUs
+    KEYFRAME_DEGREES = 1  // Joint angle; the gripper has none and reads it as percent
+};
+
+const size_t KEYFRAME_WINDOW = 512;
+
+struct KeyframeResult
+{
+    size_t rowsIn;
+    size_t rowsOut;
+    size_t bytesIn;
+    size_t bytesOut;
+    float maxDeviation; // Worst joint of all rows, in the unit, as played back
+    bool complete;      // false if out ran full (RECORDING_MAX_BYTES)
+    bool smaller;       // bytesOut < bytesIn. Fewer rows can still encode larger:
+                        // the deltas between keyframes no longer fit the short
+                        // row format. Only worth applying when true.
+};
+
+// Keyframes of in -> out (cleared first). in and out must differ.
+KeyframeResult simplifyRecording(const Recording &in, Recording &out, float tolerance, KeyframeUnit unit);
+
+// Microseconds one unit of tolerance is on servo i
+float keyframeUnitUs(int servoIndex, KeyframeUnit unit);
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef KINEMATICS_H
+#define KINEMATICS_H
+
+#include "arm_config.h"
+
+// Return type for Kinematics
+struct Coord
+{
+    float x;
+    float y;
+    float z;
+    float pitch;
+};
+
+float mapFloat(float x, float in_min, float in_max, float out_min, float out_max);
+int angleToPercent(int servoIndex, float angle);
+
+// --- JOINT UNITS ---
+// Joints are servo pulse widths in microseconds (servos[].minUs..maxUs).
+// Percent (0-100) is a UI convenience only. Angles go through the
+// piecewise-linear calibration in include/servo_cal_data.h, generated by
+// tools/fit_servo_cal.py from measured (us, angle) samples.
+float usToAngle(int servoIndex, float us);
+float angleToUs(int servoIndex, float angle);
+int percentToUs(int servoIndex, int percent); // Integer map, like Arduino map()
+float usToPercent(int servoIndex, float us);
+// Float pulse width of a joint angle, trying +/-360 deg wraps. False if no
+// wrap lands inside the servo's minUs-maxUs range.
+bool angleToUsInRange(int servoIndex, float angle_deg, float &us);
+
+// Pose of the gripper tip for the given joint state (us, index 0-3)
+Coord forwardKinematics(const int *us);
+
+// Solves joint pulses (us, index 0-3) for a tip target. Considers every branch
+// (base direct / over the top, elbow up / down) and keeps only those with all
+// joints inside their servos[] range. If current (us, index 0-3) is given,
+// the branch with the smallest joint travel from it wins.
+// Returns false (and leaves us untouched) if no branch reaches the target.
+bool inverseKinematics(float x, float y, float z, float pitch_deg, int *us, const int *current = nullptr);
+
+// How a target was mapped onto the reachable workspace
+struct IkProjection
+{
+    Coord reached;     // Pose actually solved for
+    float errorCm;     // Tip distance between requested and reached pose
+    bool projected;    // Tip moved onto the reach shell
+    bool pitchRelaxed; // Tip kept, pitch changed
+};
+
+// Like inverseKinematics(), but never fails: out-of-reach targets are first
+// tried with the closest workable pitch (if allowPitchRelax), otherwise the
+// wrist center is projected radially onto the reachable shell. Closed form.
+void inverseKinematicsNearest(float x, float y, float z, float pitch_deg, bool allowPitchRelax,
+                              int *us, IkProjection &proj, const int *current = nullptr);
+
+// --- JACOBIAN ---
+// Analytic Jacobian of the FK. q = physical joint angles in radians
+// {base, shoulder, elbow, wrist}; rows are d{x, y, z (cm), pitch (rad)}/dq.
+// Returns |det J| as a manipulability measure (0 at a singularity).
+float fkJacobian(const float *q, float J[4][4]);
+
+// Double precision originals (kinematics_ref.cpp), accuracy/speed reference
+// only. Same units and calibration as the kernels (us, usToAngle() /
+// angleToUs()); the IK only solves base direct, elbow up, with no range
+// check, like inverseKinematicsElbowUp() does in float.
+Coord forwardKinematicsRef(const int *us);
+bool inverseKinematicsRef(float x, float y, float z, float pitch_deg, int *us);
+bool inverseKinematicsElbowUp(float x, float y, float z, float pitch_deg, int *us);
+
+// --- BENCHMARK ---
+// Float kernels vs. the double reference over a fixed sweep of poses, both
+// doing the same work (see above)
+struct KinematicsBench
+{
+    int iterations;
+    uint32_t fkRefCycles; // per call
+    uint32_t fkCycles;
+    uint32_t ikRefCycles;
+    uint32_t ikCycles;      // inverseKinematicsElbowUp()
+    uint32_t trigRefCycles; // sin+cos+atan2+acos, double libm
+    uint32_t trigCycles;    // same with the float polynomials of fast_math.h
+    float fkMaxErrorCm;    // tip position, float vs. reference
+    int ikMaxErrorPercent; // joint percent, float vs. reference
+};
+KinematicsBench benchKinematics(int iterations);
+
+#endif
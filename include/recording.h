@@ -0,0 +1,138 @@
+#ifndef RECORDING_H
+#define RECORDING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// ================= RECORDING STORAGE =================
+// A recorded trajectory is kept as a byte stream, every row coded as the
+// per-joint deltas against the row before it. Each joint remembers its
+// step: the size of its last non-zero delta (a slider moved by 1% is the
+// same step again and again). Rows, first byte:
+//   ssssssss   joints 0-3, 2 bits each (joint 0 lowest): 0 = no change,
+//              1 = +step, 2 = -step, 3 = zigzag varint delta follows.
+//              Gripper unchanged.
+//   0xFF then  1rrrrrrr  run: the previous row's deltas r + 1 more times
+//                        (holds and constant speed)
+//              000mmmmm  joints in mask m changed, one varint each
+//              01000000  time: varint dt of the next row and varint new
+//                        period (ms), then the row itself
+// The first row is coded against all zeros. Decoding is a few byte reads
+// per row, so playback reads the stream directly through a Cursor.
+//
+// Timing: rows are periodMs apart unless a time prefix says otherwise. The
+// writer only emits one when the arrival time is more than
+// RECORDING_TIME_TOLERANCE_MS off that prediction, and then switches to
+// the mean period since the last correction. Radio jitter costs nothing,
+// a rate change or a dropout costs a few bytes, and every row's time is
+// within the tolerance of when it arrived.
+
+// Pulse widths in microseconds
+struct RecordedStep
+{
+    uint16_t base;
+    uint16_t shoulder;
+    uint16_t elbow;
+    uint16_t wrist;
+    uint16_t gripper;
+};
+
+const int RECORDING_JOINTS = 5;
+// Same heap as the old 2000 x 10 byte rows
+const size_t RECORDING_MAX_BYTES = 20000;
+// Rows without a time (CSV without Time_ms, demos, paths) are one frame apart
+const uint32_t RECORDING_PERIOD_MS = 20;
+const uint32_t RECORDING_TIME_TOLERANCE_MS = 3;
+
+// Decoder state of one stream, fed from RAM (Recording::Cursor) or from
+// flash (SlotReader, recording_store.h)
+class RecordingDecoder
+{
+public:
+    // Longest row: time prefix (2 + 2 uvarints) + extended row (2 + 5 varints)
+    static const size_t MAX_ROW_BYTES = 2 + 2 * 5 + 2 + 3 * RECORDING_JOINTS;
+
+    // Inside a run the next row needs no bytes
+    bool inRun() const { return run > 0; }
+    // Decodes the row at data[pos] (up to MAX_ROW_BYTES), pos moves past it
+    void next(const uint8_t *data, size_t &pos, RecordedStep &out);
+    size_t position() const { return row; } // Rows decoded so far
+    uint32_t timeMs() const { return time; } // Of the last row, first row at 0
+
+private:
+    size_t row = 0;
+    uint8_t run = 0;
+    uint32_t time = 0;
+    uint32_t period = RECORDING_PERIOD_MS;
+    uint16_t last[RECORDING_JOINTS] = {0, 0, 0, 0, 0};
+    int16_t delta[RECORDING_JOINTS] = {0, 0, 0, 0, 0};
+    uint16_t step[RECORDING_JOINTS] = {0, 0, 0, 0, 0};
+};
+
+class Recording
+{
+public:
+    // Reads rows in order. Stays valid while the recording grows; after
+    // clear() or spill() it just reports the end.
+    class Cursor
+    {
+    public:
+        bool next(RecordedStep &step); // false at the end
+        size_t position() const { return dec.position(); } // Rows read so far
+        uint32_t timeMs() const { return dec.timeMs(); } // Of the last row read, first row at 0
+
+    private:
+        friend class Recording;
+        const Recording *rec = nullptr;
+        uint32_t generation = 0;
+        size_t pos = 0;
+        RecordingDecoder dec;
+    };
+
+    void clear();
+    // false (nothing stored) once the row does not fit RECORDING_MAX_BYTES.
+    // timeMs is the arrival time on any clock (halMillis()), without it the
+    // row is one period after the last.
+    bool append(const RecordedStep &step, uint32_t timeMs);
+    bool append(const RecordedStep &step);
+    // Time prefix threshold for the timed append, until clear().
+    // 0 keeps every time exact (keyframes, see keyframes.h).
+    void setTimeTolerance(uint32_t ms) { timeTolerance = ms; }
+    Cursor cursor() const; // Ends at once on a spilled recording
+    // Same take, nothing appended or cleared since one was copied from the other
+    bool sameAs(const Recording &other) const { return generation == other.generation && rows == other.rows; }
+
+    // Streaming the take out (to flash) while it is recorded: the first
+    // finalBytes() of raw() never change again (a run can still count up
+    // behind them). spill(n) drops the first n bytes from RAM once they
+    // are stored elsewhere; appending goes on as before.
+    const uint8_t *raw() const { return data.data(); }
+    size_t finalBytes() const { return runAt == SIZE_MAX ? data.size() : runAt; }
+    void spill(size_t n);
+    size_t spilled() const { return spilledBytes; }
+
+    size_t size() const { return rows; }
+    bool empty() const { return rows == 0; }
+    size_t bytes() const { return data.size(); } // In RAM
+    uint32_t durationMs() const { return time; } // Time of the last row
+
+private:
+    std::vector<uint8_t> data;
+    size_t rows = 0;
+    size_t spilledBytes = 0;
+    uint32_t generation = 0;
+    size_t runAt = SIZE_MAX; // Run byte that can still count up
+    bool repeated = false;   // Last row repeated the deltas before it
+    uint32_t startMs = 0;    // Arrival time of the first row
+    uint32_t time = 0;       // Stored time of the last row (since startMs)
+    uint32_t period = RECORDING_PERIOD_MS;
+    uint32_t timeTolerance = RECORDING_TIME_TOLERANCE_MS;
+    uint32_t anchorMs = 0;   // Time and row of the last correction
+    size_t anchorRow = 0;
+    uint16_t last[RECORDING_JOINTS] = {0, 0, 0, 0, 0};
+    int16_t delta[RECORDING_JOINTS] = {0, 0, 0, 0, 0};
+    uint16_t step[RECORDING_JOINTS] = {0, 0, 0, 0, 0};
+};
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef RECORDING_STORE_H
+#define RECORDING_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "recording.h"
+
+// ================= RECORDING SLOTS =================
+// Named recordings on the flash filesystem, one file per slot:
+// /rec/<name>.rec, a 4 byte magic and then the stream of recording.h as is.
+// Flash I/O blocks for milliseconds, so the control task never touches a
+// file. Two SPSC rings carry the bytes and recordingStoreService(), called
+// from the network task, does the reading and writing:
+//   Recording: rows go into recordingBuffer as always; every tick the
+//   control loop moves the final bytes into the write ring and spills them
+//   from RAM (slotRecordTick). RAM only holds what is not written yet, so a
+//   take is as long as the flash allows.
+//   Playing: the service keeps the read ring full from the file, playback
+//   decodes rows out of it (SlotReader) and never waits on the flash.
+
+const int SLOT_NAME_MAX = 24;          // Letters, digits, '-' and '_'
+const size_t SLOT_RING_BYTES = 1024;   // Per direction, ~10 s of dense motion
+const uint32_t SLOT_SYNC_MS = 1000;    // Commit the take to flash this often
+
+// --- NETWORK TASK ---
+bool recordingStoreBegin(); // Mounts the filesystem, from setup()
+void recordingStoreService(); // Every pass of the network task
+
+bool slotNameValid(const char *name);
+// Creates (or replaces) the slot for a new take, then startSlotRecording()
+// under the control lock. false if the name is bad or a take is still
+// being written (slotBusy()).
+bool slotRecordOpen(const char *name);
+bool slotBusy();
+// Opens the slot and fills the read-ahead, then startSlotPlayback() under
+// the control lock. Playback must be stopped before.
+bool slotPlayOpen(const char *name);
+bool slotRemove(const char *name);
+void slotList(void (*onSlot)(const char *name, uint32_t bytes, void *ctx), void *ctx);
+// Decodes a whole slot in the calling task (downloads). Stops at a row the
+// file ends in the middle of (power lost mid-take).
+bool slotDecode(const char *name, void (*onRow)(const RecordedStep &step, uint32_t timeMs, void *ctx),
+                void *ctx);
+// slotDecode() in two halves, so a caller can answer a missing slot before
+// it starts: slotOpenRead() returns -1 if there is none, slotDecodeFile()
+// decodes the opened file and closes it.
+int slotOpenRead(const char *name);
+void slotDecodeFile(int file, void (*onRow)(const RecordedStep &step, uint32_t timeMs, void *ctx), void *ctx);
+const char *slotCurrent(); // Last slot recorded or played, "" if none
+
+// --- CONTROL TASK ---
+// Rows of the slot being played, from the read ring
+class SlotReader
+{
+public:
+    void reset();
+    bool next(RecordedStep &step); // false at the end or while the ring is dry
+    bool ended() const { return end && pos >= len && !dec.inRun(); }
+    size_t position() const { return dec.position(); }
+    uint32_t timeMs() const { return dec.timeMs(); }
+    uint32_t starved = 0; // Rows that were due while the ring was dry
+
+private:
+    RecordingDecoder dec;
+    uint8_t buf[2 * RecordingDecoder::MAX_ROW_BYTES + 4];
+    size_t pos = 0;
+    size_t len = 0;
+    bool end = false;
+};
+extern SlotReader slotReader;
+
+void slotRecordStart(); // Take recordingBuffer to the slot opened for it
+void slotRecordEnd();   // Recording stopped: the rest of the take goes out
+void slotRecordTick();  // Every control tick
+
+#endif
@@ -0,0 +1,26 @@
+// GENERATED by tools/fit_servo_cal.py - do not edit.
+// Base: linear (angle0/angle100)
+// Shoulder: linear (angle0/angle100)
+// Elbow: linear (angle0/angle100)
+// Wrist: linear (angle0/angle100)
+// Gripper: linear (angle0/angle100)
+#ifndef SERVO_CAL_DATA_H
+#define SERVO_CAL_DATA_H
+
+constexpr int SERVO_CAL_SERVOS = 5;
+constexpr int SERVO_CAL_POINTS = 13;
+
+// Knots are evenly spaced from SERVO_CAL_MIN_US to SERVO_CAL_MAX_US
+constexpr int SERVO_CAL_MIN_US[5] = {500, 500, 500, 500, 600};
+constexpr int SERVO_CAL_MAX_US[5] = {2500, 2200, 2500, 2500, 1500};
+
+// Joint angle (deg) at every knot. constexpr -> flash (.rodata)
+constexpr float SERVO_CAL_ANGLE[5][13] = {
+    {85.0000f, 72.4333f, 59.8667f, 47.3000f, 34.7333f, 22.1667f, 9.6000f, -2.9667f, -15.5333f, -28.1000f, -40.6667f, -53.2333f, -65.8000f}, // Base
+    {180.0000f, 165.0000f, 150.0000f, 135.0000f, 120.0000f, 105.0000f, 90.0000f, 75.0000f, 60.0000f, 45.0000f, 30.0000f, 15.0000f, 0.0000f}, // Shoulder
+    {172.0000f, 159.6950f, 147.3900f, 135.0850f, 122.7800f, 110.4750f, 98.1700f, 85.8650f, 73.5600f, 61.2550f, 48.9500f, 36.6450f, 24.3400f}, // Elbow
+    {94.5000f, 105.8167f, 117.1333f, 128.4500f, 139.7667f, 151.0833f, 162.4000f, 173.7167f, 185.0333f, 196.3500f, 207.6667f, 218.9833f, 230.3000f}, // Wrist
+    {0.0000f, 0.0000f, 0.0000f, 0.0000f, 0.0000f, 0.0000f, 0.0000f, 0.0000f, 0.0000f, 0.0000f, 0.0000f, 0.0000f, 0.0000f}, // Gripper
+};
+
+#endif
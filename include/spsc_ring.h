@@ -0,0 +1,83 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// ================= SPSC RING =================
+// Fixed size ring between exactly one producer and one consumer task, no
+// lock: each side only writes its own index, the other index is read with
+// acquire and published with release, so an element is complete before the
+// other side can see it. N must be a power of two; holds up to N elements.
+template <typename T, size_t N>
+class SpscRing
+{
+    static_assert(N > 1 && (N & (N - 1)) == 0, "SpscRing: N must be a power of two");
+
+public:
+    // --- PRODUCER ---
+    bool push(const T &v)
+    {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) >= N)
+            return false;
+        buf[h & (N - 1)] = v;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // As many of v[0..n) as fit, returns the count taken
+    size_t push(const T *v, size_t n)
+    {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        size_t free = N - (h - tail.load(std::memory_order_acquire));
+        n = n < free ? n : free;
+        for (size_t i = 0; i < n; i++)
+            buf[(h + i) & (N - 1)] = v[i];
+        head.store(h + (uint32_t)n, std::memory_order_release);
+        return n;
+    }
+
+    size_t space() const { return N - size(); }
+
+    // --- CONSUMER ---
+    bool pop(T &v)
+    {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (head.load(std::memory_order_acquire) == t)
+            return false;
+        v = buf[t & (N - 1)];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Up to n elements into v, returns the count
+    size_t pop(T *v, size_t n)
+    {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        size_t used = head.load(std::memory_order_acquire) - t;
+        n = n < used ? n : used;
+        for (size_t i = 0; i < n; i++)
+            v[i] = buf[(t + i) & (N - 1)];
+        tail.store(t + (uint32_t)n, std::memory_order_release);
+        return n;
+    }
+
+    // --- EITHER SIDE ---
+    size_t size() const { return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire); }
+    bool empty() const { return size() == 0; }
+    // Only while neither side is using the ring
+    void reset()
+    {
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    T buf[N];
+    std::atomic<uint32_t> head{0}; // Written by the producer only
+    std::atomic<uint32_t> tail{0}; // Written by the consumer only
+};
+
+#endif
@@ -181,7 +181,8 @@ const char PAGE_JS[] PROGMEM = R"rawliteral(
     const y = document.getElementById('ikY').value;
     const z = document.getElementById('ikZ').value;
     const p = document.getElementById('ikP').value;
-    fetch(`/set_xyz?x=${x}&y=${y}&z=${z}&p=${p}`);
+    const speed = document.getElementById('ikSpeed').value;
+    fetch(`/set_xyz?x=${x}&y=${y}&z=${z}&p=${p}&speed=${speed}`);
   }
 
   function uploadScript() {
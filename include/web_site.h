@@ -110,6 +110,7 @@ const char PAGE_HTML_BODY[] PROGMEM = R"rawliteral(
         <div class="input-wrapper"><label>Y</label><input type="number" id="ikY" step="0.1" value="0"></div>
         <div class="input-wrapper"><label>Z</label><input type="number" id="ikZ" step="0.1" value="10"></div>
         <div class="input-wrapper"><label>Pitch</label><input type="number" id="ikP" step="1" value="0"></div>
+        <div class="input-wrapper"><label>cm/s</label><input type="number" id="ikSpeed" step="0.5" min="0.5" value="5"></div>
       </div>
       <button onclick="sendIK()">Move to XYZ</button>
     </div>
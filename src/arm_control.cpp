@@ -0,0 +1,845 @@
+#include "arm_control.h"
+#include "cartesian_motion.h"
+#include "joint_motion.h"
+#include "recording_store.h"
+#include "spsc_ring.h"
+#include "hal.h"
+#include <atomic>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+// --- RECORDING DATA ---
+Recording recordingBuffer;
+bool isRecording = false;
+bool isPlaying = false;
+size_t playStep = 0;
+int playbackMode = PLAYBACK_INTERPOLATE;
+bool ikReachable = true;
+float ikErrorCm = 0;
+
+// --- MODES ---
+int currentMode = MODE_CONTROLLER;
+ScriptState scriptRunner = {false, 0, 0, 0};
+
+// internal state (us), homeServos() sets the real startUs
+int currentUs[NUM_SERVOS] = {1500, 500, 2500, 1800, 600};
+volatile uint32_t jointVersion = 1;
+
+// FK cache. fkSeq is odd while fkPose is being written (seqlock), so
+// cachedFK() readers on another task never see a half written pose.
+static Coord fkPose = {0, 0, 0, 0};
+static uint32_t fkVersion = 0;
+static volatile uint32_t fkSeq = 0;
+
+// --- SERVO FRAME ---
+// Staged and last written tick of every PCA9685 channel. Only channels in
+// stagedMask whose tick differs from the written one (or that were never
+// written) go on the bus.
+FrameStats frameStats = {0, 0, 0, 0, 0, 0};
+static uint16_t frameTicks[16];
+static uint16_t writtenTicks[16];
+static uint16_t stagedMask = 0;
+static uint16_t writtenMask = 0;
+
+static void stageChannel(uint8_t channel, uint16_t ticks)
+{
+    frameTicks[channel] = ticks;
+    stagedMask |= 1 << channel;
+}
+
+// --- MOTION PROFILE ---
+// Trapezoidal velocity profile from the pulse on the wire (outputUs) to the
+// commanded pulse (currentUs), advanced by commitServoFrame()
+int outputUs[NUM_SERVOS] = {1500, 500, 2500, 1800, 600};
+struct JointProfile
+{
+    float pos; // us
+    float vel; // us/s
+    bool pending; // Commanded since the last commit
+    bool planned; // Last command came in under profileBypassMask
+};
+static JointProfile profiles[NUM_SERVOS];
+static uint32_t profileLastUs = 0;
+uint8_t profileBypassMask = 0;
+bool motionProfileEnabled = true;
+// Longest step the profile integrates at once (first tick, stalls)
+static const float PROFILE_MAX_DT = 0.05f;
+
+static bool profileSettled(int i)
+{
+    return profiles[i].vel == 0.0f && profiles[i].pos == (float)currentUs[i];
+}
+
+// No profile: the output steps to the command on the next tick
+static bool profileOff(int i)
+{
+    return !motionProfileEnabled || servos[i].maxVelUsS <= 0.0f;
+}
+
+static void profileStep(int i, float dt)
+{
+    JointProfile &jp = profiles[i];
+    const ServoConfig &cfg = servos[i];
+    float target = (float)currentUs[i];
+    float e = target - jp.pos;
+    if (profileOff(i))
+    {
+        jp.pos = target;
+        jp.vel = 0.0f;
+        return;
+    }
+    if (dt <= 0.0f)
+        return;
+
+    // Fastest speed that can still stop at the target, capped at vmax. The
+    // half step term makes the braking exact for a tick of dt.
+    float dir = e < 0.0f ? -1.0f : 1.0f;
+    float want = cfg.maxVelUsS;
+    if (cfg.maxAccUsS2 > 0.0f)
+    {
+        float h = 0.5f * cfg.maxAccUsS2 * dt;
+        float stop = sqrtf(h * h + 2.0f * cfg.maxAccUsS2 * fabsf(e)) - h;
+        if (stop < want)
+            want = stop;
+        float dv = dir * want - jp.vel;
+        float dvMax = cfg.maxAccUsS2 * dt;
+        jp.vel += dv > dvMax ? dvMax : (dv < -dvMax ? -dvMax : dv);
+    }
+    else
+    {
+        jp.vel = dir * want;
+    }
+
+    float step = jp.vel * dt;
+    if (step * dir >= fabsf(e) || fabsf(e) < 0.5f)
+    {
+        jp.pos = target; // Arrived (the last step is shorter than a tick)
+        jp.vel = 0.0f;
+    }
+    else
+    {
+        jp.pos += step;
+    }
+}
+
+// Advances every moving joint and stages its channel
+static void profileTick()
+{
+    uint32_t now = halMicros();
+    float dt = (now - profileLastUs) * 1e-6f;
+    if (dt > PROFILE_MAX_DT)
+        dt = PROFILE_MAX_DT;
+    profileLastUs = now;
+
+    for (int i = 0; i < NUM_SERVOS; i++)
+    {
+        JointProfile &jp = profiles[i];
+        if (!jp.pending && profileSettled(i))
+            continue;
+        if (jp.planned && (jp.pending || (profileBypassMask & (1 << i))))
+        {
+            // Planned upstream: follow, but keep the rate so the profile
+            // can brake from it if the plan is cut short
+            float target = (float)currentUs[i];
+            jp.vel = dt > 0.0f ? (target - jp.pos) / dt : 0.0f;
+            jp.pos = target;
+        }
+        else if (!profileSettled(i))
+            profileStep(i, dt);
+        jp.pending = false;
+        outputUs[i] = (int)lroundf(jp.pos);
+        stageChannel(servos[i].pin, usToTicks(outputUs[i]));
+    }
+}
+
+// --- HELPER FUNCTIONS ---
+
+// Microseconds to PWM ticks (0-4096) for every pulse a servo can get,
+// built by the compiler into flash
+struct TickTable
+{
+    uint16_t ticks[servoMaxUs() + 1];
+    constexpr TickTable() : ticks()
+    {
+        for (int us = 0; us <= servoMaxUs(); us++)
+            ticks[us] = (uint16_t)((uint32_t)us * 4096 / SERVO_FRAME_US);
+    }
+};
+static constexpr TickTable tickTable;
+
+int usToTicks(int microseconds)
+{
+    if (microseconds < 0)
+        microseconds = 0;
+    if (microseconds > servoMaxUs())
+        microseconds = servoMaxUs();
+    return tickTable.ticks[microseconds];
+}
+
+// Moves a specific servo by index to a pulse width (us)
+void moveServoUs(int servoIndex, int us)
+{
+    const ServoConfig &cfg = servos[servoIndex];
+
+    // Hard-Limit Safety
+    if (us < cfg.minUs)
+        us = cfg.minUs;
+    if (us > cfg.maxUs)
+        us = cfg.maxUs;
+
+    // Save global state for kinematics
+    if (currentUs[servoIndex] != us)
+    {
+        currentUs[servoIndex] = us;
+        jointVersion = jointVersion + 1;
+    }
+
+    // The profile stages the channel on the next commit. A move's last
+    // command still passes through after the move cleared its mask.
+    profiles[servoIndex].pending = true;
+    profiles[servoIndex].planned = (profileBypassMask >> servoIndex) & 1;
+}
+
+// Moves a specific servo by index using percentage (0-100)
+void moveServo(int servoIndex, int percent)
+{
+    if (percent < 0)
+        percent = 0;
+    if (percent > 100)
+        percent = 100;
+    moveServoUs(servoIndex, percentToUs(servoIndex, percent));
+}
+
+int servoPercent(int servoIndex)
+{
+    return (int)lroundf(usToPercent(servoIndex, currentUs[servoIndex]));
+}
+
+void homeServos()
+{
+    for (int i = 0; i < NUM_SERVOS; i++)
+    {
+        // Position unknown before the first pulse, no profile
+        moveServoUs(i, servos[i].startUs);
+        profiles[i].pos = (float)currentUs[i];
+        profiles[i].vel = 0.0f;
+    }
+    commitServoFrame();
+}
+
+bool servosSettled(uint8_t mask)
+{
+    for (int i = 0; i < NUM_SERVOS; i++)
+        if ((mask & (1 << i)) && !profileOff(i) && !profileSettled(i))
+            return false;
+    return true;
+}
+
+bool settleServos(uint8_t mask)
+{
+    for (int i = 0; i < NUM_SERVOS; i++)
+    {
+        if (!(mask & (1 << i)) || profileOff(i) || profileSettled(i))
+            continue;
+        const JointProfile &jp = profiles[i];
+        float a = servos[i].maxAccUsS2;
+        float stop = jp.pos + (a > 0.0f ? jp.vel * fabsf(jp.vel) / (2.0f * a) : 0.0f);
+        moveServoUs(i, (int)lroundf(stop)); // Not planned: the profile brakes to it
+    }
+    return servosSettled(mask);
+}
+
+uint32_t commitServoFrame()
+{
+    profileTick();
+    if (!stagedMask)
+        return 0;
+
+    uint16_t dirty = 0;
+    for (int ch = 0; ch < 16; ch++)
+    {
+        uint16_t bit = 1 << ch;
+        if (!(stagedMask & bit))
+            continue;
+        if ((writtenMask & bit) && writtenTicks[ch] == frameTicks[ch])
+            frameStats.suppressed++;
+        else
+            dirty |= bit;
+    }
+    stagedMask = 0;
+    if (!dirty)
+        return 0;
+
+    // One burst per run of consecutive dirty channels. Only a burst that
+    // made it counts as written; a lost one stays staged for the next frame.
+    uint32_t busUs = 0;
+    uint16_t lost = 0;
+    int ch = 0;
+    while (ch < 16)
+    {
+        if (!(dirty & (1 << ch)))
+        {
+            ch++;
+            continue;
+        }
+        int first = ch;
+        while (ch < 16 && (dirty & (1 << ch)))
+            ch++;
+        uint16_t run = (uint16_t)((1 << ch) - (1 << first));
+        uint32_t us;
+        if (halWriteBurst(first, &frameTicks[first], ch - first, us))
+        {
+            for (int c = first; c < ch; c++)
+                writtenTicks[c] = frameTicks[c];
+            writtenMask |= run;
+            frameStats.writes += ch - first;
+        }
+        else
+        {
+            writtenMask &= ~run;
+            lost |= run;
+            frameStats.lost += ch - first;
+        }
+        busUs += us;
+    }
+    stagedMask |= lost;
+
+    frameStats.frames++;
+    frameStats.lastBusUs = busUs;
+    if (busUs > frameStats.maxBusUs)
+        frameStats.maxBusUs = busUs;
+    return busUs;
+}
+
+// --- FRAME LOCK ---
+// Slot n of the current frame clock is FRAME_LEAD_US before frame n + 1
+FrameLockStats frameLock = {0, 0, 0};
+static HalFrameClock lockClock = {0, 0, 0};
+static uint32_t lockSlot = 0;
+static uint32_t lockSinceSync = 0;
+
+static uint32_t slotUs(uint32_t n)
+{
+    return lockClock.originUs + (uint32_t)((uint64_t)(n + 1) * lockClock.periodNs / 1000) - FRAME_LEAD_US;
+}
+
+// First slot after nowUs
+static uint32_t slotAfter(uint32_t nowUs)
+{
+    int32_t since = (int32_t)(nowUs - lockClock.originUs);
+    uint32_t elapsed = (since > 0 ? since : 0) + FRAME_LEAD_US;
+    return (uint32_t)((uint64_t)elapsed * 1000 / lockClock.periodNs);
+}
+
+// halBegin(), halSetOscillator() and resyncs move the frame clock
+static void followFrameClock(uint32_t nowUs)
+{
+    HalFrameClock c = halFrameClock();
+    if (c.originUs == lockClock.originUs && c.periodNs == lockClock.periodNs)
+        return;
+    lockClock = c;
+    lockSlot = slotAfter(nowUs);
+    lockSinceSync = 0;
+}
+
+uint32_t nextFrameSlotUs()
+{
+    followFrameClock(halMicros());
+    return slotUs(lockSlot);
+}
+
+static bool frameSlotReached(uint32_t nowUs)
+{
+    followFrameClock(nowUs);
+    if ((int32_t)(nowUs - slotUs(lockSlot)) < 0)
+        return false;
+    uint32_t next = slotAfter(nowUs);
+    frameLock.slots++;
+    frameLock.missed += next - lockSlot - 1;
+    lockSlot = next;
+    return true;
+}
+
+// After the slot's commit: still ahead of the frame (all outputs low), so
+// restarting the counter here only shortens this one frame
+static bool restartPending = false;
+static uint32_t restartDueUs = 0;
+
+static void frameSlotDone()
+{
+    if (++lockSinceSync < FRAME_RESYNC_FRAMES || restartPending)
+        return;
+    uint32_t frameUs = slotUs(lockSlot - 1) + FRAME_LEAD_US;
+    if ((int32_t)(frameUs - halMicros()) < (int32_t)(halFrameRestartUs() + FRAME_RESTART_SLACK_US))
+        return; // Would run into the frame, try next slot
+    if (!halStopFrame())
+        return;
+    restartPending = true;
+    restartDueUs = halMicros() + HAL_PCA9685_STARTUP_US;
+}
+
+bool frameRestartPending(uint32_t &restartUs)
+{
+    restartUs = restartDueUs;
+    return restartPending;
+}
+
+void finishFrameRestart()
+{
+    if (!restartPending)
+        return;
+    halRestartFrame();
+    restartPending = false;
+    frameLock.resyncs++;
+}
+
+// --- KINEMATICS ---
+Coord calculateFK()
+{
+    uint32_t version = jointVersion;
+    if (version != fkVersion)
+    {
+        Coord pose = forwardKinematics(currentUs);
+        fkSeq = fkSeq + 1;
+        std::atomic_thread_fence(std::memory_order_release);
+        fkPose = pose;
+        std::atomic_thread_fence(std::memory_order_release);
+        fkSeq = fkSeq + 1;
+        fkVersion = version;
+    }
+    return fkPose;
+}
+
+Coord cachedFK()
+{
+    for (;;)
+    {
+        uint32_t seq = fkSeq;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        Coord pose = fkPose;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (!(seq & 1) && seq == fkSeq)
+            return pose;
+    }
+}
+
+IkProjection calculateIK(float x, float y, float z, float pitch_deg, bool relaxPitch)
+{
+    int target[4];
+    IkProjection proj;
+    inverseKinematicsNearest(x, y, z, pitch_deg, relaxPitch, target, proj, currentUs);
+
+    // Out of reach targets still move, to the closest reachable pose
+    ikReachable = !proj.projected && !proj.pitchRelaxed;
+    ikErrorCm = proj.errorCm;
+    if (proj.projected)
+        halLog("IK Target Unreachable, moved to nearest reachable pose");
+
+    moveServoUs(0, target[0]);
+    moveServoUs(1, target[1]);
+    moveServoUs(2, target[2]);
+    moveServoUs(3, target[3]);
+    return proj;
+}
+
+// --- INPUTS ---
+// --- CONTROLLER QUEUE ---
+struct ControllerPacket
+{
+    struct_message msg;
+    uint32_t timeMs; // Arrival
+};
+static SpscRing<ControllerPacket, CONTROLLER_QUEUE_LEN> controllerQueue;
+ControllerQueueStats controllerQueueStats = {};
+
+bool queueControllerInput(const struct_message &msg, uint32_t timeMs)
+{
+    if (!controllerQueue.push({msg, timeMs}))
+    {
+        controllerQueueStats.dropped++;
+        return false;
+    }
+    controllerQueueStats.received++;
+    return true;
+}
+
+static void drainControllerQueue()
+{
+    ControllerPacket packet;
+    uint32_t depth = 0;
+    while (controllerQueue.pop(packet))
+    {
+        applyControllerInput(packet.msg, packet.timeMs);
+        depth++;
+    }
+    if (depth > controllerQueueStats.maxDepth)
+        controllerQueueStats.maxDepth = depth;
+}
+
+void applyControllerInput(const struct_message &msg, uint32_t timeMs)
+{
+    if (currentMode != MODE_CONTROLLER)
+        return;
+
+    // Ignore controller input if playing back recording
+    if (isPlaying)
+        return;
+
+    // Update logic matching Code 1
+    moveServo(0, msg.base);
+    moveServo(1, msg.shoulder);
+    moveServo(2, msg.elbow);
+    moveServo(3, msg.wrist);
+
+    // Gripper logic: bool to 0/100
+    int gripperPercent = msg.grabber ? 100 : 0;
+    moveServo(4, gripperPercent);
+
+    // Recording Logic
+    if (isRecording)
+    {
+        recordStep({(uint16_t)currentUs[0],
+                    (uint16_t)currentUs[1],
+                    (uint16_t)currentUs[2],
+                    (uint16_t)currentUs[3],
+                    (uint16_t)currentUs[4]},
+                   timeMs);
+    }
+}
+
+void setControlMode(int mode)
+{
+    currentMode = mode;
+    stopCartesianMotion();
+    stopJointMove();
+    if (currentMode != MODE_SCRIPT)
+        scriptRunner.active = false;
+
+    // Stop recording if leaving controller mode
+    if (currentMode != MODE_CONTROLLER)
+    {
+        isRecording = false;
+    }
+}
+
+void startScript(int id)
+{
+    stopCartesianMotion();
+    stopJointMove();
+    currentMode = MODE_SCRIPT;
+    scriptRunner.active = true;
+    scriptRunner.scriptId = id;
+    scriptRunner.step = 0;
+    scriptRunner.lastStepTime = 0;
+}
+
+// --- RECORDING ---
+void startRecording()
+{
+    slotRecordEnd();
+    isRecording = true;
+    isPlaying = false;
+    recordingBuffer.clear();
+}
+
+void startSlotRecording()
+{
+    startRecording();
+    slotRecordStart();
+}
+
+void stopRecording()
+{
+    isRecording = false;
+    isPlaying = false;
+    slotRecordEnd();
+}
+
+// --- PLAYBACK ---
+// Rows come from recordingBuffer or, streamed from flash, from slotReader.
+// The source is read one row ahead: playFrom is the last row that is due,
+// playTo the next one.
+static Recording::Cursor playCursor;
+static bool playSlot = false;
+static RecordedStep playFrom, playTo;
+static uint32_t playFromMs, playToMs;
+static bool playHasTo = false;
+static bool playStarted = false;
+static unsigned long playStartTime = 0;
+
+static bool playNext(RecordedStep &step, uint32_t &timeMs)
+{
+    bool ok = playSlot ? slotReader.next(step) : playCursor.next(step);
+    timeMs = playSlot ? slotReader.timeMs() : playCursor.timeMs();
+    return ok;
+}
+
+// false while a slot's read-ahead is only late
+static bool playEnded()
+{
+    return !playSlot || slotReader.ended();
+}
+
+static void beginPlayback(bool fromSlot)
+{
+    stopJointMove();
+    stopRecording();
+    isPlaying = true;
+    playStep = 0;
+    playSlot = fromSlot;
+    if (fromSlot)
+        slotReader.reset();
+    else
+        playCursor = recordingBuffer.cursor();
+    playHasTo = playNext(playTo, playToMs);
+    playStarted = false;
+}
+
+void startPlayback()
+{
+    beginPlayback(false);
+}
+
+void startSlotPlayback()
+{
+    beginPlayback(true);
+}
+
+static void playStepOut(const RecordedStep &step)
+{
+    moveServoUs(0, step.base);
+    moveServoUs(1, step.shoulder);
+    moveServoUs(2, step.elbow);
+    moveServoUs(3, step.wrist);
+    moveServoUs(4, step.gripper);
+}
+
+static int lerpUs(uint16_t a, uint16_t b, float f)
+{
+    return (int)lroundf(a + (b - (float)a) * f);
+}
+
+// Frame slot: recorded time runs from the first slot, so the first row
+// goes out at once and the frames after it each see at most one new row
+static void playbackTick()
+{
+    unsigned long now = halMillis();
+    if (!playStarted)
+    {
+        playStartTime = now;
+        playStarted = true;
+    }
+    uint32_t t = now - playStartTime;
+
+    if (!playHasTo)
+        playHasTo = playNext(playTo, playToMs); // Read-ahead was dry last frame
+    bool advanced = false;
+    while (playHasTo && playToMs <= t)
+    {
+        playFrom = playTo;
+        playFromMs = playToMs;
+        playStep++;
+        advanced = true;
+        playHasTo = playNext(playTo, playToMs);
+    }
+    if (!playHasTo)
+    {
+        if (advanced)
+            playStepOut(playFrom); // Last row exactly, or hold until the flash catches up
+        if (playEnded())
+            isPlaying = false; // Done
+        return;
+    }
+    if (playStep == 0)
+        return;
+
+    if (playbackMode == PLAYBACK_INTERPOLATE)
+    {
+        float f = (float)(t - playFromMs) / (float)(playToMs - playFromMs);
+        moveServoUs(0, lerpUs(playFrom.base, playTo.base, f));
+        moveServoUs(1, lerpUs(playFrom.shoulder, playTo.shoulder, f));
+        moveServoUs(2, lerpUs(playFrom.elbow, playTo.elbow, f));
+        moveServoUs(3, lerpUs(playFrom.wrist, playTo.wrist, f));
+        moveServoUs(4, lerpUs(playFrom.gripper, playTo.gripper, f));
+    }
+    else if (advanced)
+    {
+        playStepOut(playFrom);
+    }
+}
+
+void clearRecording()
+{
+    slotRecordEnd();
+    recordingBuffer.clear();
+    isPlaying = false;
+}
+
+void recordStep(const RecordedStep &step, uint32_t timeMs)
+{
+    if (!recordingBuffer.append(step, timeMs))
+    {
+        stopRecording();
+        halLog("Recording full, stopped");
+    }
+}
+
+void processLine(const char *line)
+{
+    if (strncmp(line, "Base", 4) == 0)
+        return; // Header
+
+    int v[NUM_SERVOS];
+    unsigned long timeMs = 0;
+    int cols = sscanf(line, "%d,%d,%d,%d,%d,%lu", &v[0], &v[1], &v[2], &v[3], &v[4], &timeMs);
+    if (cols >= 5)
+    {
+        // Rows are microseconds or (older files, demos) percent. Every
+        // minUs is above 100, so a row with all values above 100 is in us.
+        bool inUs = true;
+        for (int i = 0; i < NUM_SERVOS; i++)
+            inUs = inUs && v[i] > 100;
+        uint16_t us[NUM_SERVOS];
+        for (int i = 0; i < NUM_SERVOS; i++)
+        {
+            int u = inUs ? v[i] : percentToUs(i, v[i] < 0 ? 0 : v[i]);
+            u = u < servos[i].minUs ? servos[i].minUs : (u > servos[i].maxUs ? servos[i].maxUs : u);
+            us[i] = (uint16_t)u;
+        }
+        // Dropped once full. Without Time_ms rows are one frame apart.
+        if (cols == 6)
+            recordingBuffer.append({us[0], us[1], us[2], us[3], us[4]}, (uint32_t)timeMs);
+        else
+            recordingBuffer.append({us[0], us[1], us[2], us[3], us[4]});
+    }
+}
+
+void loadRecordingCsv(const char *csv)
+{
+    clearRecording();
+
+    // PROGMEM is memory mapped on the ESP32, so the text is read directly
+    char lineBuffer[64];
+    size_t len = 0;
+    for (const char *c = csv;; c++)
+    {
+        if (*c == '\n' || *c == '\r' || *c == 0)
+        {
+            if (len > 0)
+            {
+                lineBuffer[len] = 0;
+                processLine(lineBuffer);
+                len = 0;
+            }
+            if (*c == 0)
+                break; // End of string
+        }
+        else if (len < sizeof(lineBuffer) - 1)
+        {
+            lineBuffer[len++] = *c;
+        }
+    }
+}
+
+// --- CONTROL LOOP ---
+void controlTick()
+{
+    // A restart the control task didn't finish yet
+    if (restartPending && (int32_t)(halMicros() - restartDueUs) >= 0)
+        finishFrameRestart();
+
+    // 50Hz work only in the frame slot
+    bool frameDue = frameSlotReached(halMicros());
+
+    // Controller packets that arrived since the last tick
+    drainControllerQueue();
+
+    // Cartesian interpolation (MOVEL, jog) and synchronized joint moves
+    cartesianMotionTick(frameDue);
+    jointMotionTick();
+
+    // Playback Logic, in the frame slot
+    if (isPlaying && frameDue)
+        playbackTick();
+    slotRecordTick(); // Take being recorded to flash
+
+    if (currentMode == MODE_SCRIPT && scriptRunner.active)
+    {
+        unsigned long now = halMillis();
+        // Script 1: Wave
+        if (scriptRunner.scriptId == 1)
+        {
+            if (scriptRunner.step == 0 && (now - scriptRunner.lastStepTime > 100))
+            {
+                // Elbow Up, Wrist mid, arriving together
+                int us[NUM_SERVOS] = {0, 0, percentToUs(2, 50), percentToUs(3, 50), 0};
+                startJointMove(us, 0x0C);
+                scriptRunner.step++;
+                scriptRunner.lastStepTime = now;
+            }
+            else if (scriptRunner.step == 1 && (now - scriptRunner.lastStepTime > 1000))
+            {
+                moveServo(3, 80); // Wrist Up
+                scriptRunner.step++;
+                scriptRunner.lastStepTime = now;
+            }
+            else if (scriptRunner.step == 2 && (now - scriptRunner.lastStepTime > 500))
+            {
+                moveServo(3, 20); // Wrist Down
+                scriptRunner.step++;
+                scriptRunner.lastStepTime = now;
+            }
+            else if (scriptRunner.step == 3 && (now - scriptRunner.lastStepTime > 500))
+            {
+                moveServo(3, 80); // Wrist Up
+                scriptRunner.step++;
+                scriptRunner.lastStepTime = now;
+            }
+            else if (scriptRunner.step == 4 && (now - scriptRunner.lastStepTime > 500))
+            {
+                moveServo(3, 50);            // Center
+                scriptRunner.active = false; // Done
+            }
+        }
+        // Script 2: Pick Place Demo
+        else if (scriptRunner.scriptId == 2)
+        {
+            if (scriptRunner.step == 0)
+            {
+                moveServo(4, 0);          // Open
+                startJointMoveToXYZ(15, 0, 5, 0); // Go down
+                scriptRunner.step++;
+                scriptRunner.lastStepTime = now;
+            }
+            else if (scriptRunner.step == 1 && (now - scriptRunner.lastStepTime > 2000))
+            {
+                moveServo(4, 100); // Close
+                scriptRunner.step++;
+                scriptRunner.lastStepTime = now;
+            }
+            else if (scriptRunner.step == 2 && (now - scriptRunner.lastStepTime > 1000))
+            {
+                startJointMoveToXYZ(15, 0, 15, 0); // Up
+                scriptRunner.step++;
+                scriptRunner.lastStepTime = now;
+            }
+            else if (scriptRunner.step == 3 && (now - scriptRunner.lastStepTime > 2000))
+            {
+                scriptRunner.active = false;
+            }
+        }
+        else if (scriptRunner.scriptId == 3)
+        {
+            scriptRunner.active = false;
+        }
+    }
+
+    // Everything moved this pass goes out as one frame
+    commitServoFrame();
+    if (frameDue)
+        frameSlotDone();
+
+    // Refresh the pose for cachedFK() readers (free if nothing moved)
+    calculateFK();
+}
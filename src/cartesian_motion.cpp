@@ -0,0 +1,434 @@
+#include "cartesian_motion.h"
+#include "arm_control.h"
+#include "joint_motion.h"
+#include "ik_grid.h"
+#include "hal.h"
+#include "fast_math.h"
+#include <math.h>
+
+// Pitch only moves have no tip distance, they run at this rate instead
+static const float PITCH_RATE_DPS = 45.0f;
+// How far an intermediate point may be pulled onto the reach shell
+static const float PATH_TOLERANCE_CM = 0.5f;
+// Most points a line is checked at before it starts, one per tick below that
+static const int LINE_CHECK_POINTS = 256;
+// Points the line's joint trajectory is solved at for its timing
+static const int LINE_TIMING_POINTS = 64;
+// Whole-us rounding of those solves, not taken for path curvature
+static const float LINE_ROUNDING_US = 2.0f;
+// Slowest IK rate a MOVEL falls back to while solves overrun their budget
+static const uint8_t LINEAR_MAX_STRIDE = 4;
+
+// Jog: below this |det J| (cm^3) damping fades in, up to JOG_MAX_DAMPING
+static const float JOG_SINGULAR_DET = 50.0f;
+static const float JOG_MAX_DAMPING = 3.0f;
+// Fastest joint rate a jog may ask for
+static const float JOG_MAX_JOINT_DPS = 90.0f;
+
+LinearMove linearMove = {false, {0, 0, 0, 0}, {0, 0, 0, 0}, 0, 0, 0, 0, 0, 0, 0, 1, 0, false};
+JogState jog = {};
+float linearSpeedCmS = 5.0f;
+
+// Shortest turn from one pitch to another, in [-180, 180)
+static float pitchDelta(float from, float to)
+{
+    float d = fmodf(to - from + 180.0f, 360.0f);
+    if (d < 0.0f)
+        d += 360.0f;
+    return d - 180.0f;
+}
+
+// Walks the line a -> b at the control rate before it starts, the IK grid
+// answers most points in O(1), the exact IK the ones near the boundary.
+// False if the line leaves the workspace.
+static bool lineInWorkspace(const int *from, const Coord &a, const Coord &b, float durationMs, float &errorCm)
+{
+    int points = (int)(durationMs / CARTESIAN_PERIOD_MS);
+    points = points < 1 ? 1 : (points > LINE_CHECK_POINTS ? LINE_CHECK_POINTS : points);
+    int near[4] = {from[0], from[1], from[2], from[3]};
+    for (int k = 1; k <= points; k++)
+    {
+        float t = (float)k / points;
+        float x = a.x + (b.x - a.x) * t;
+        float y = a.y + (b.y - a.y) * t;
+        float z = a.z + (b.z - a.z) * t;
+        float p = a.pitch + (b.pitch - a.pitch) * t;
+        float seed[4];
+        if (ikGridReachableExact(x, y, z, p, seed))
+        {
+            for (int j = 0; j < 4; j++)
+                near[j] = (int)seed[j];
+            continue;
+        }
+        // Grazing the reach shell is fine, as in linearMoveTick()
+        int pos[4];
+        IkProjection proj;
+        inverseKinematicsNearest(x, y, z, p, false, pos, proj, near);
+        if (proj.errorCm > PATH_TOLERANCE_CM)
+        {
+            errorCm = proj.errorCm;
+            return false;
+        }
+        for (int j = 0; j < 4; j++)
+            near[j] = pos[j];
+    }
+    return true;
+}
+
+// Times the line on the trapezoidal time scaling s(t) of joint moves:
+// cruise at ds/dt = 1/c, ramps of Ta at 1/(c Ta). With q'(s) and q''(s) of
+// the joint trajectory (solved like linearMoveTick() does), joint j sees
+//   speed  q' / c                        <= maxVelUsS
+//   ramp   q' / (c Ta) + q'' / c^2       <= maxAccUsS2
+// Half the acceleration goes to each term. c starts at durationMs (the
+// nominal tip speed) and only grows.
+static void timeLine(const int *from, const Coord &a, const Coord &b, float &durationMs, float &rampMs)
+{
+    float q[LINE_TIMING_POINTS + 1][4];
+    for (int j = 0; j < 4; j++)
+        q[0][j] = (float)from[j];
+    for (int k = 1; k <= LINE_TIMING_POINTS; k++)
+    {
+        float t = (float)k / LINE_TIMING_POINTS;
+        int near[4] = {(int)q[k - 1][0], (int)q[k - 1][1], (int)q[k - 1][2], (int)q[k - 1][3]};
+        int pos[4];
+        IkProjection proj;
+        inverseKinematicsNearest(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t,
+                                 a.pitch + (b.pitch - a.pitch) * t, false, pos, proj, near);
+        for (int j = 0; j < 4; j++)
+            q[k][j] = (float)pos[j];
+    }
+
+    const float n = (float)LINE_TIMING_POINTS;
+    float c = durationMs * 0.001f;
+    float A = 0.0f; // c * Ta the ramps need
+    for (int j = 0; j < 4; j++)
+    {
+        float vmax = servos[j].maxVelUsS, amax = servos[j].maxAccUsS2;
+        float d1 = 0.0f, d2 = 0.0f;
+        for (int k = 1; k <= LINE_TIMING_POINTS; k++)
+        {
+            d1 = fmaxf(d1, fabsf(q[k][j] - q[k - 1][j]) * n);
+            if (k < LINE_TIMING_POINTS)
+                d2 = fmaxf(d2, (fabsf(q[k + 1][j] - 2.0f * q[k][j] + q[k - 1][j]) - LINE_ROUNDING_US) * n * n);
+        }
+        if (vmax > 0.0f)
+            c = fmaxf(c, d1 / vmax);
+        if (amax > 0.0f)
+        {
+            A = fmaxf(A, 2.0f * d1 / amax);
+            c = fmaxf(c, sqrtf(2.0f * d2 / amax));
+        }
+    }
+    c = fmaxf(c, sqrtf(A)); // Triangle: no cruise left
+    float ramp = c > 0.0f ? A / c : 0.0f;
+    durationMs = (c + ramp) * 1000.0f;
+    rampMs = ramp * 1000.0f;
+}
+
+void planLinearMove(const int *from, float x, float y, float z, float pitch_deg, bool relaxPitch, float speedCmS,
+                    LinePlan &plan)
+{
+    for (int j = 0; j < 4; j++)
+        plan.from[j] = from[j];
+    // Out of reach targets become the nearest reachable pose
+    int pos[4];
+    IkProjection &proj = plan.proj;
+    inverseKinematicsNearest(x, y, z, pitch_deg, relaxPitch, pos, proj, from);
+    x = proj.reached.x;
+    y = proj.reached.y;
+    z = proj.reached.z;
+    pitch_deg = proj.reached.pitch;
+
+    Coord start = forwardKinematics(from);
+    // The line turns the short way: past +/-180 the target pitch runs on
+    pitch_deg = start.pitch + pitchDelta(start.pitch, pitch_deg);
+    float dx = x - start.x;
+    float dy = y - start.y;
+    float dz = z - start.z;
+    float dist = sqrtf(dx * dx + dy * dy + dz * dz);
+    float speed = speedCmS > 0.1f ? speedCmS : 0.1f;
+    float durationMs = dist / speed * 1000.0f;
+    float pitchMs = fabsf(pitch_deg - start.pitch) / PITCH_RATE_DPS * 1000.0f;
+    if (pitchMs > durationMs)
+        durationMs = pitchMs;
+
+    plan.start = start;
+    plan.target = {x, y, z, pitch_deg};
+    plan.rampMs = 0.0f;
+    float blockedCm;
+    plan.blocked = !lineInWorkspace(from, start, plan.target, durationMs, blockedCm);
+    if (plan.blocked)
+        proj.errorCm = blockedCm;
+    else
+        timeLine(from, start, plan.target, durationMs, plan.rampMs);
+    plan.durationMs = durationMs;
+}
+
+bool startPlannedLinearMove(const LinePlan &plan)
+{
+    jog.active = false;
+    stopJointMove();
+    for (int j = 0; j < 4; j++)
+    {
+        if (currentUs[j] != plan.from[j])
+            return false; // Moved since, the plan starts somewhere else
+    }
+    if (plan.blocked)
+    {
+        halLog("MOVEL: path leaves workspace, not started");
+        linearMove.active = false;
+        ikReachable = false;
+        ikErrorCm = plan.proj.errorCm;
+        return false;
+    }
+    ikReachable = !plan.proj.projected && !plan.proj.pitchRelaxed;
+    ikErrorCm = plan.proj.errorCm;
+
+    // Joints still braking from earlier commands: the line waits for them
+    unsigned long now = halMillis();
+    linearMove.waiting = !servosSettled(CARTESIAN_JOINTS);
+    profileBypassMask = linearMove.waiting ? 0 : CARTESIAN_JOINTS;
+    linearMove.active = true;
+    linearMove.start = plan.start;
+    linearMove.target = plan.target;
+    linearMove.durationMs = plan.durationMs;
+    linearMove.rampMs = plan.rampMs;
+    linearMove.startTime = now;
+    linearMove.lastTick = now;
+    linearMove.stride = 1;
+    linearMove.waited = 0;
+    return true;
+}
+
+IkProjection startLinearMove(float x, float y, float z, float pitch_deg, bool relaxPitch)
+{
+    stopCartesianMotion();
+    stopJointMove();
+    settleServos(CARTESIAN_JOINTS);
+    LinePlan plan;
+    planLinearMove(currentUs, x, y, z, pitch_deg, relaxPitch, linearSpeedCmS, plan);
+    startPlannedLinearMove(plan);
+    return plan.proj;
+}
+
+void startJog(float vx, float vy, float vz, float vpitch, unsigned long durationMs)
+{
+    linearMove.active = false;
+    stopJointMove();
+    unsigned long now = halMillis();
+    if (!jog.active)
+    {
+        // Joints still moving stay on the profile for this jog, it limits the steps
+        profileBypassMask = servosSettled(CARTESIAN_JOINTS) ? CARTESIAN_JOINTS : 0;
+        for (int i = 0; i < 4; i++)
+        {
+            jog.angle[i] = usToAngle(i, currentUs[i]);
+            jog.commanded[i] = currentUs[i];
+        }
+        jog.lastTick = now;
+    }
+    jog.velocity[0] = vx;
+    jog.velocity[1] = vy;
+    jog.velocity[2] = vz;
+    jog.velocity[3] = vpitch;
+    jog.endTime = durationMs ? now + durationMs : 0;
+    jog.active = true;
+}
+
+void stopCartesianMotion()
+{
+    if (linearMove.active || jog.active)
+        profileBypassMask &= ~CARTESIAN_JOINTS;
+    linearMove.active = false;
+    jog.active = false;
+}
+
+static void linearMoveTick(unsigned long now)
+{
+    if (linearMove.waiting)
+    {
+        if (!servosSettled(CARTESIAN_JOINTS))
+            return;
+        linearMove.waiting = false;
+        linearMove.startTime = now;
+        profileBypassMask = CARTESIAN_JOINTS;
+    }
+
+    float t = timeScaling((float)(now - linearMove.startTime), linearMove.durationMs, linearMove.rampMs);
+
+    // The budget holds on average: while solves overrun it, only every
+    // stride-th frame solves and the frames between hold the last command.
+    // The line keeps its timing, the arrival is always solved.
+    if (t < 1.0f && ++linearMove.waited < linearMove.stride)
+        return;
+    linearMove.waited = 0;
+
+    const Coord &a = linearMove.start;
+    const Coord &b = linearMove.target;
+    int pos[4];
+
+    uint32_t t0 = halMicros();
+    IkProjection proj;
+    inverseKinematicsNearest(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t,
+                             a.pitch + (b.pitch - a.pitch) * t, false, pos, proj, currentUs);
+    uint32_t solveUs = halMicros() - t0;
+
+    linearMove.lastSolveUs = solveUs;
+    if (solveUs > linearMove.maxSolveUs)
+        linearMove.maxSolveUs = solveUs;
+    if (solveUs > CARTESIAN_IK_BUDGET_US)
+    {
+        linearMove.overruns++;
+        if (linearMove.stride < LINEAR_MAX_STRIDE)
+            linearMove.stride++;
+    }
+    else if (solveUs < CARTESIAN_IK_BUDGET_US / 2 && linearMove.stride > 1)
+        linearMove.stride--;
+
+    // The line can leave the workspace even if both ends are inside it.
+    // Grazing the reach shell is fine, leaving it for real stops the move.
+    if (proj.errorCm > PATH_TOLERANCE_CM)
+    {
+        halLog("MOVEL: path leaves workspace, stopped");
+        ikReachable = false;
+        ikErrorCm = proj.errorCm;
+        stopCartesianMotion();
+        return;
+    }
+
+    moveServoUs(0, pos[0]);
+    moveServoUs(1, pos[1]);
+    moveServoUs(2, pos[2]);
+    moveServoUs(3, pos[3]);
+
+    if (t >= 1.0f)
+        stopCartesianMotion(); // Arrived
+}
+
+// Solves (A) x = b for a symmetric positive definite 4x4 A (Cholesky)
+static void solve4(float A[4][4], float *b)
+{
+    for (int j = 0; j < 4; j++)
+    {
+        float d = A[j][j];
+        for (int k = 0; k < j; k++)
+            d -= A[j][k] * A[j][k];
+        d = sqrtf(d > 1e-12f ? d : 1e-12f);
+        A[j][j] = d;
+        for (int i = j + 1; i < 4; i++)
+        {
+            float v = A[i][j];
+            for (int k = 0; k < j; k++)
+                v -= A[i][k] * A[j][k];
+            A[i][j] = v / d;
+        }
+    }
+    for (int i = 0; i < 4; i++)
+    {
+        for (int k = 0; k < i; k++)
+            b[i] -= A[i][k] * b[k];
+        b[i] /= A[i][i];
+    }
+    for (int i = 3; i >= 0; i--)
+    {
+        for (int k = i + 1; k < 4; k++)
+            b[i] -= A[k][i] * b[k];
+        b[i] /= A[i][i];
+    }
+}
+
+static void jogTick(unsigned long now)
+{
+    float dt = (now - jog.lastTick) * 0.001f;
+    jog.lastTick = now;
+    if (jog.endTime && (long)(now - jog.endTime) >= 0)
+    {
+        stopCartesianMotion();
+        return;
+    }
+
+    // Something else moved the servos (slider, playback), continue from there
+    for (int i = 0; i < 4; i++)
+    {
+        if (currentUs[i] != jog.commanded[i])
+        {
+            jog.angle[i] = usToAngle(i, currentUs[i]);
+            jog.commanded[i] = currentUs[i];
+        }
+    }
+
+    float q[4];
+    for (int i = 0; i < 4; i++)
+        q[i] = jog.angle[i] * DEG_TO_RAD_F;
+    float J[4][4];
+    float m = fkJacobian(q, J);
+
+    // Damped least squares: dq = J^T (J J^T + lambda^2 I)^-1 v
+    float lambda = 0.0f;
+    if (m < JOG_SINGULAR_DET)
+        lambda = JOG_MAX_DAMPING * (1.0f - m / JOG_SINGULAR_DET);
+    jog.manipulability = m;
+    jog.damping = lambda;
+
+    float A[4][4];
+    for (int i = 0; i < 4; i++)
+    {
+        for (int j = 0; j < 4; j++)
+        {
+            float v = 0.0f;
+            for (int k = 0; k < 4; k++)
+                v += J[i][k] * J[j][k];
+            A[i][j] = v;
+        }
+        A[i][i] += lambda * lambda;
+    }
+    float y[4] = {jog.velocity[0], jog.velocity[1], jog.velocity[2], jog.velocity[3] * DEG_TO_RAD_F};
+    solve4(A, y);
+
+    float rate[4]; // deg/s
+    float fastest = 0.0f;
+    for (int j = 0; j < 4; j++)
+    {
+        float v = 0.0f;
+        for (int i = 0; i < 4; i++)
+            v += J[i][j] * y[i];
+        rate[j] = v * RAD_TO_DEG_F;
+        if (fabsf(rate[j]) > fastest)
+            fastest = fabsf(rate[j]);
+    }
+    // Scale all joints together so the tip keeps its direction
+    float scale = fastest > JOG_MAX_JOINT_DPS ? JOG_MAX_JOINT_DPS / fastest : 1.0f;
+
+    jog.limitMask = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        float a = jog.angle[i] + rate[i] * scale * dt;
+        float u = angleToUs(i, a);
+        if (u < servos[i].minUs || u > servos[i].maxUs)
+        {
+            u = u < servos[i].minUs ? servos[i].minUs : servos[i].maxUs;
+            a = usToAngle(i, u);
+            jog.limitMask |= 1 << i;
+        }
+        jog.angle[i] = a;
+        int us = (int)lroundf(u);
+        if (us != currentUs[i])
+            moveServoUs(i, us);
+        jog.commanded[i] = us;
+    }
+}
+
+void cartesianMotionTick(bool frameDue)
+{
+    if (!frameDue)
+        return;
+    unsigned long now = halMillis();
+    if (linearMove.active)
+    {
+        linearMove.lastTick = now;
+        linearMoveTick(now);
+    }
+    if (jog.active && now != jog.lastTick)
+        jogTick(now);
+}
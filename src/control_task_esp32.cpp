@@ -0,0 +1,119 @@
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include "control_task.h"
+#include "arm_control.h"
+
+ControlTiming controlTiming = {0, 0, 0, 0, 0, 0};
+
+static SemaphoreHandle_t controlMutex = nullptr;
+static TaskHandle_t controlTaskHandle = nullptr;
+static esp_timer_handle_t slotTimer = nullptr;
+static volatile bool timingResetPending = false;
+
+void controlLock()
+{
+    if (controlMutex)
+        xSemaphoreTake(controlMutex, portMAX_DELAY);
+}
+
+void controlUnlock()
+{
+    if (controlMutex)
+        xSemaphoreGive(controlMutex);
+}
+
+// Picked up by the task, so the counters are only ever written on core 1
+void resetControlTiming()
+{
+    timingResetPending = true;
+}
+
+// esp_timer task context, not an ISR
+static void slotTimerFired(void *)
+{
+    xTaskNotifyGive(controlTaskHandle);
+}
+
+// The FreeRTOS tick (1ms) is too coarse for the slot, the esp_timer runs
+// on the same clock as micros(). Only the last SLOT_SPIN_US are spun, at
+// priority 5 that is all core 1 gets taken from the tasks below.
+const int32_t SLOT_SPIN_US = 5;
+
+static void sleepUntil(uint32_t targetUs)
+{
+    for (;;)
+    {
+        int32_t wait = (int32_t)(targetUs - micros());
+        if (wait <= 0)
+            return;
+        if (wait <= SLOT_SPIN_US)
+            break;
+        esp_timer_start_once(slotTimer, wait);
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+    while ((int32_t)(micros() - targetUs) < 0)
+    {
+    }
+}
+
+static void controlTask(void *)
+{
+    for (;;)
+    {
+        controlLock();
+        uint32_t slot = nextFrameSlotUs();
+        controlUnlock();
+        sleepUntil(slot);
+
+        uint32_t woke = micros();
+        uint32_t late = woke - slot; // After a stall frameLock.missed counts the slots in between
+
+        uint32_t restartUs;
+        controlLock();
+        controlTick();
+        bool restart = frameRestartPending(restartUs);
+        controlUnlock();
+        uint32_t run = micros() - woke;
+
+        // The PCA9685 oscillator starts up without the lock held
+        if (restart)
+        {
+            sleepUntil(restartUs);
+            controlLock();
+            finishFrameRestart();
+            controlUnlock();
+        }
+
+        if (timingResetPending)
+        {
+            controlTiming = {0, 0, 0, 0, 0, 0};
+            timingResetPending = false;
+        }
+        controlTiming.ticks++;
+        controlTiming.lastJitterUs = late;
+        controlTiming.lastRunUs = run;
+        if (late > controlTiming.maxJitterUs)
+            controlTiming.maxJitterUs = late;
+        if (run > controlTiming.maxRunUs)
+            controlTiming.maxRunUs = run;
+        // The commit missed the pulse it was meant for
+        if (late + run > FRAME_LEAD_US)
+            controlTiming.overruns++;
+    }
+}
+
+void startControlTask()
+{
+    if (controlTaskHandle)
+        return;
+    controlMutex = xSemaphoreCreateMutex();
+    esp_timer_create_args_t args = {};
+    args.callback = slotTimerFired;
+    args.name = "frame_slot";
+    esp_timer_create(&args, &slotTimer);
+    xTaskCreatePinnedToCore(controlTask, "control", 8192, nullptr, CONTROL_TASK_PRIORITY,
+                            &controlTaskHandle, CONTROL_TASK_CORE);
+}
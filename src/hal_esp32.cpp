@@ -0,0 +1,296 @@
+#include <Arduino.h>
+#include <Wire.h>
+#include <Adafruit_PWMServoDriver.h>
+#include <Preferences.h>
+#include <LittleFS.h>
+#include "hal.h"
+
+// --- HARDWARE OBJECTS ---
+const uint8_t PCA9685_ADDR = 0x40; // Adafruit_PWMServoDriver default
+const uint8_t PCA9685_MODE1 = 0x00;
+const uint8_t PCA9685_SUBADR1 = 0x02;
+const uint8_t MODE1_RESTART = 0x80;
+const uint8_t MODE1_SLEEP = 0x10;
+const float PWM_FREQ_HZ = 50;
+Adafruit_PWMServoDriver pwm = Adafruit_PWMServoDriver();
+
+static HalBusStatus busStatus = {100000, 0, 0};
+static int clockStep = HAL_I2C_CLOCK_COUNT - 1;
+static HalFrameClock frameClock = {0, 20000000, HAL_PCA9685_OSC_HZ};
+
+static void setBusClock(int step)
+{
+    clockStep = step;
+    busStatus.clockHz = HAL_I2C_CLOCKS[step];
+    Wire.setClock(busStatus.clockHz);
+}
+
+static bool writeRegs(uint8_t reg, const uint8_t *data, uint8_t count)
+{
+    Wire.beginTransmission(PCA9685_ADDR);
+    Wire.write(reg);
+    for (uint8_t i = 0; i < count; i++)
+        Wire.write(data[i]);
+    return Wire.endTransmission() == 0;
+}
+
+static bool readRegs(uint8_t reg, uint8_t *data, uint8_t count)
+{
+    Wire.beginTransmission(PCA9685_ADDR);
+    Wire.write(reg);
+    if (Wire.endTransmission(false) != 0)
+        return false;
+    if (Wire.requestFrom(PCA9685_ADDR, count) != count)
+        return false;
+    for (uint8_t i = 0; i < count; i++)
+        data[i] = Wire.read();
+    return true;
+}
+
+// SUBADR1-3 are inert while MODE1.SUBx is off: write a pattern, read it
+// back, restore the power-on values
+static bool busSelfTest()
+{
+    static const uint8_t pattern[3] = {0xA5, 0x5A, 0xC3};
+    static const uint8_t defaults[3] = {0xE2, 0xE4, 0xE8};
+    uint8_t back[3] = {0, 0, 0};
+    bool ok = writeRegs(PCA9685_SUBADR1, pattern, 3) && readRegs(PCA9685_SUBADR1, back, 3) &&
+              memcmp(back, pattern, 3) == 0;
+    return writeRegs(PCA9685_SUBADR1, defaults, 3) && ok;
+}
+
+// --- FRAME CLOCK ---
+// Same prescaler as Adafruit_PWMServoDriver::setPWMFreq() picks
+static void setFrameClock(uint32_t oscHz)
+{
+    float prescale = oscHz / (PWM_FREQ_HZ * 4096.0f) + 0.5f - 1.0f;
+    prescale = prescale < 3 ? 3 : (prescale > 255 ? 255 : prescale);
+    frameClock.oscHz = oscHz;
+    frameClock.periodNs = (uint32_t)(((uint8_t)prescale + 1) * 4096ULL * 1000000000ULL / oscHz);
+}
+
+// setPWMFreq() ends with MODE1.RESTART, the counter starts over right there
+static void startPwm(uint32_t oscHz)
+{
+    setFrameClock(oscHz);
+    pwm.setOscillatorFrequency(oscHz);
+    pwm.setPWMFreq(PWM_FREQ_HZ);
+    frameClock.originUs = micros();
+}
+
+static uint32_t storedOscillator()
+{
+    Preferences prefs;
+    prefs.begin("pca9685", true);
+    uint32_t hz = prefs.getUInt("osc", HAL_PCA9685_OSC_HZ);
+    prefs.end();
+    return hz;
+}
+
+HalFrameClock halFrameClock()
+{
+    return frameClock;
+}
+
+void halSetOscillator(uint32_t oscHz)
+{
+    startPwm(oscHz ? oscHz : HAL_PCA9685_OSC_HZ);
+}
+
+void halStoreOscillator(uint32_t oscHz)
+{
+    Preferences prefs;
+    prefs.begin("pca9685", false);
+    prefs.putUInt("osc", oscHz ? oscHz : HAL_PCA9685_OSC_HZ);
+    prefs.end();
+}
+
+// Sleep stops the oscillator and sets RESTART; after wake-up and the
+// 500us the oscillator needs, writing RESTART starts every channel at
+// counter 0 again
+static uint8_t restartMode = MODE1_RESTART;
+
+bool halStopFrame()
+{
+    uint8_t mode;
+    if (!readRegs(PCA9685_MODE1, &mode, 1))
+    {
+        busStatus.errors++;
+        return false; // Keep the old origin, the counter kept running
+    }
+    mode &= ~MODE1_RESTART;
+    uint8_t sleep = mode | MODE1_SLEEP;
+    uint8_t wake = mode & ~MODE1_SLEEP;
+    restartMode = wake | MODE1_RESTART;
+    bool ok = writeRegs(PCA9685_MODE1, &sleep, 1);
+    ok = writeRegs(PCA9685_MODE1, &wake, 1) && ok;
+    if (!ok)
+        busStatus.errors++;
+    return true; // halRestartFrame() still has to clear SLEEP
+}
+
+// Also clears SLEEP, so a lost wake-up cannot leave the outputs off
+void halRestartFrame()
+{
+    if (!writeRegs(PCA9685_MODE1, &restartMode, 1))
+        busStatus.errors++;
+    frameClock.originUs = micros();
+}
+
+// MODE1 read (4 bytes on the wire) and three 3-byte writes, 9 clocks per
+// byte, plus the Wire driver's set-up per transaction
+const uint32_t WIRE_TRANSACTION_US = 50;
+
+uint32_t halFrameRestartUs()
+{
+    return HAL_PCA9685_STARTUP_US + (13 * 9 * 1000000UL + busStatus.clockHz - 1) / busStatus.clockHz +
+           4 * WIRE_TRANSACTION_US;
+}
+
+void halBegin()
+{
+    Wire.begin(21, 22);
+
+    // PWM Init (at the 100kHz default), on the calibrated oscillator
+    pwm.begin();
+    startPwm(storedOscillator());
+
+    // Fast-mode (Plus) if the wiring allows it
+    for (int step = 0; step < HAL_I2C_CLOCK_COUNT; step++)
+    {
+        setBusClock(step);
+        if (busSelfTest())
+            break;
+        busStatus.errors++;
+        if (step + 1 < HAL_I2C_CLOCK_COUNT)
+            busStatus.fallbacks++;
+    }
+
+    char msg[64];
+    snprintf(msg, sizeof(msg), "I2C %lu Hz (%lu fallbacks)", (unsigned long)busStatus.clockHz,
+             (unsigned long)busStatus.fallbacks);
+    halLog(msg);
+    snprintf(msg, sizeof(msg), "PCA9685 %lu Hz oscillator, %lu ns frame", (unsigned long)frameClock.oscHz,
+             (unsigned long)frameClock.periodNs);
+    halLog(msg);
+}
+
+HalBusStatus halBusStatus()
+{
+    return busStatus;
+}
+
+uint32_t halMillis()
+{
+    return millis();
+}
+
+uint32_t halMicros()
+{
+    return micros();
+}
+
+uint32_t halCycles()
+{
+    return ESP.getCycleCount();
+}
+
+void halSetPWM(uint8_t channel, uint16_t on, uint16_t off)
+{
+    pwm.setPWM(channel, on, off);
+}
+
+// setPWMFreq() leaves MODE1.AI set, so the register pointer advances
+// through LEDn_ON_L..LEDn_OFF_H and on into the next channel
+bool halWriteBurst(uint8_t firstChannel, const uint16_t *offTicks, uint8_t count, uint32_t &busUs)
+{
+    uint32_t start = micros();
+    bool sent = false;
+    for (;;)
+    {
+        Wire.beginTransmission(PCA9685_ADDR);
+        Wire.write(PCA9685_LED0_ON_L + 4 * firstChannel);
+        for (uint8_t i = 0; i < count; i++)
+        {
+            Wire.write(0);
+            Wire.write(0);
+            Wire.write(offTicks[i] & 0xFF);
+            Wire.write(offTicks[i] >> 8);
+        }
+        if (Wire.endTransmission() == 0)
+        {
+            sent = true;
+            break;
+        }
+
+        busStatus.errors++;
+        if (clockStep + 1 >= HAL_I2C_CLOCK_COUNT)
+            break; // Already at the slowest clock, the caller retries
+        setBusClock(clockStep + 1);
+        busStatus.fallbacks++;
+    }
+    busUs = micros() - start;
+    return sent;
+}
+
+// --- FILES ---
+static File files[HAL_FILE_MAX];
+
+bool halFileBegin()
+{
+    return LittleFS.begin(true); // Formats a blank partition
+}
+
+int halFileOpen(const char *path, const char *mode)
+{
+    for (int i = 0; i < HAL_FILE_MAX; i++)
+    {
+        if (files[i])
+            continue;
+        files[i] = LittleFS.open(path, mode, mode[0] == 'w'); // Creates the dirs
+        return files[i] ? i : -1;
+    }
+    return -1;
+}
+
+int halFileRead(int file, uint8_t *buf, int len)
+{
+    return files[file].read(buf, len);
+}
+
+int halFileWrite(int file, const uint8_t *buf, int len)
+{
+    return files[file].write(buf, len);
+}
+
+void halFileSync(int file)
+{
+    files[file].flush();
+}
+
+void halFileClose(int file)
+{
+    files[file].close();
+}
+
+bool halFileRemove(const char *path)
+{
+    return LittleFS.remove(path);
+}
+
+void halFileList(const char *dir, void (*onFile)(const char *name, uint32_t size, void *ctx), void *ctx)
+{
+    File d = LittleFS.open(dir);
+    if (!d || !d.isDirectory())
+        return;
+    for (File f = d.openNextFile(); f; f = d.openNextFile())
+    {
+        if (!f.isDirectory())
+            onFile(f.name(), f.size(), ctx);
+    }
+}
+
+void halLog(const char *msg)
+{
+    Serial.println(msg);
+}
@@ -0,0 +1,101 @@
+#include "ik_batch.h"
+#include "ik_grid.h"
+#include <stdio.h>
+#include <string.h>
+
+static uint8_t clampPercent(int p)
+{
+    if (p < 0)
+        return 0;
+    if (p > 100)
+        return 100;
+    return (uint8_t)p;
+}
+
+IkBatchResult solveIKBatch(const CartesianWaypoint *points, size_t count, std::vector<RecordedStep> &out,
+                           uint8_t *reachable, const int *from)
+{
+    IkBatchResult result = {0, -1, false};
+    out.clear();
+    out.reserve(count);
+    if (reachable)
+        memset(reachable, 0, count);
+
+    // Each point picks the branch closest to the previous one, the first
+    // point the one closest to where the arm is now
+    if (!from)
+        from = currentUs;
+    int prev[4] = {from[0], from[1], from[2], from[3]};
+    for (size_t i = 0; i < count; i++)
+    {
+        const CartesianWaypoint &wp = points[i];
+        int pos[4];
+        if (!inverseKinematics(wp.x, wp.y, wp.z, wp.pitch, pos, prev))
+        {
+            result.firstUnreachable = (long)i;
+            break;
+        }
+        if (reachable)
+            reachable[i] = 1;
+        for (int j = 0; j < 4; j++)
+            prev[j] = pos[j];
+
+        // IK results are inside the servo ranges already
+        out.push_back({(uint16_t)pos[0], (uint16_t)pos[1], (uint16_t)pos[2], (uint16_t)pos[3],
+                       (uint16_t)percentToUs(4, wp.gripper)});
+    }
+    result.solved = out.size();
+    return result;
+}
+
+long checkCartesianPath(const CartesianWaypoint *points, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        const CartesianWaypoint &wp = points[i];
+        if (!ikGridReachableExact(wp.x, wp.y, wp.z, wp.pitch))
+            return (long)i;
+    }
+    return -1;
+}
+
+bool parseWaypointLine(const char *line, CartesianWaypoint &wp)
+{
+    int gripper = 0;
+    int n = sscanf(line, "%f,%f,%f,%f,%d", &wp.x, &wp.y, &wp.z, &wp.pitch, &gripper);
+    if (n < 4)
+        return false; // Header
+    wp.gripper = clampPercent(gripper);
+    return true;
+}
+
+IkBatchResult solvePathRecording(const CartesianWaypoint *points, size_t count, const int *from, Recording &out)
+{
+    out.clear();
+    // A path that can't be played fails before anything is solved
+    long unreachable = checkCartesianPath(points, count);
+    if (unreachable >= 0)
+        return {0, unreachable, false};
+
+    std::vector<RecordedStep> steps;
+    IkBatchResult result = solveIKBatch(points, count, steps, nullptr, from);
+    result.solved = 0;
+    for (const RecordedStep &step : steps)
+    {
+        if (!out.append(step))
+        {
+            result.tooLong = true;
+            break;
+        }
+        result.solved++;
+    }
+    return result;
+}
+
+void playSolvedPath(const Recording &path)
+{
+    clearRecording();
+    recordingBuffer = path;
+    if (!recordingBuffer.empty())
+        startPlayback();
+}
@@ -0,0 +1,95 @@
+#include <stddef.h>
+#include "ik_grid.h"
+#include "ik_grid_data.h"
+#include "kinematics.h"
+#include "fast_math.h"
+
+// Splits a coordinate into node index + fraction, false if outside the axis
+static bool gridAxis(float v, float vMin, float step, int count, int &i, float &f)
+{
+    float t = (v - vMin) / step;
+    if (t < 0.0f || t > (float)(count - 1))
+        return false;
+    i = (int)t;
+    if (i >= count - 1)
+        i = count - 2;
+    f = t - (float)i;
+    return true;
+}
+
+// Trilinear blend of the 8 nodes around (r, z, pitch), r signed (R < 0 is
+// over the top). False unless all 8 solve on the same elbow branch.
+static bool gridBlend(float r, float z, float pitch_deg, float *joints)
+{
+    int ir, iz, ip;
+    float fr, fz, fp;
+    if (!gridAxis(r, IK_GRID_R_MIN, IK_GRID_R_STEP, IK_GRID_R_COUNT, ir, fr) ||
+        !gridAxis(z, IK_GRID_Z_MIN, IK_GRID_Z_STEP, IK_GRID_Z_COUNT, iz, fz) ||
+        !gridAxis(pitch_deg, IK_GRID_P_MIN, IK_GRID_P_STEP, IK_GRID_P_COUNT, ip, fp))
+        return false;
+
+    uint16_t branch = 0;
+    joints[0] = joints[1] = joints[2] = 0.0f;
+    for (int corner = 0; corner < 8; corner++)
+    {
+        int dr = corner & 1;
+        int dz = (corner >> 1) & 1;
+        int dp = (corner >> 2) & 1;
+        size_t node = ((size_t)(ip + dp) * IK_GRID_Z_COUNT + (iz + dz)) * IK_GRID_R_COUNT + (ir + dr);
+        const uint16_t *cell = &IK_GRID[node * 3];
+        if (cell[0] == IK_GRID_UNREACHABLE)
+            return false;
+        uint16_t down = cell[1] & IK_GRID_ELBOW_DOWN;
+        if (corner == 0)
+            branch = down;
+        else if (down != branch)
+            return false; // Seeds of two branches don't blend
+
+        float w = (dr ? fr : 1.0f - fr) * (dz ? fz : 1.0f - fz) * (dp ? fp : 1.0f - fp);
+        joints[0] += w * cell[0];
+        joints[1] += w * (cell[1] & ~IK_GRID_ELBOW_DOWN);
+        joints[2] += w * cell[2];
+    }
+    return true;
+}
+
+bool ikGridLookup(float x, float y, float z, float pitch_deg, float *seed)
+{
+    float theta1 = fastAtan2(y, x) * RAD_TO_DEG_F;
+    float R = sqrtf(x * x + y * y);
+    if (R < 0.1f)
+        R = 0.1f;
+
+    // Base direct first, then turned 180 deg, like inverseKinematics()
+    for (int flip = 0; flip < 2; flip++)
+    {
+        float base, joints[3];
+        if (!angleToUsInRange(0, flip ? theta1 + 180.0f : theta1, base) ||
+            !gridBlend(flip ? -R : R, z, pitch_deg, joints))
+            continue;
+        if (seed)
+        {
+            seed[0] = base;
+            seed[1] = joints[0];
+            seed[2] = joints[1];
+            seed[3] = joints[2];
+        }
+        return true;
+    }
+    return false;
+}
+
+bool ikGridReachableExact(float x, float y, float z, float pitch_deg, float *seed)
+{
+    if (ikGridLookup(x, y, z, pitch_deg, seed))
+        return true;
+    int us[4];
+    if (!inverseKinematics(x, y, z, pitch_deg, us))
+        return false;
+    if (seed)
+    {
+        for (int i = 0; i < 4; i++)
+            seed[i] = (float)us[i];
+    }
+    return true;
+}
@@ -0,0 +1,121 @@
+#include "joint_motion.h"
+#include "arm_control.h"
+#include "cartesian_motion.h"
+#include "hal.h"
+#include <math.h>
+
+JointMove jointMove = {};
+
+float startJointMove(const int *targetUs, uint8_t mask, float speed)
+{
+    stopCartesianMotion();
+    if (speed <= 0.0f || speed > 1.0f)
+        speed = 1.0f;
+    // The move starts where the joints come to rest
+    profileBypassMask = 0;
+    bool settled = settleServos(mask);
+
+    // Time scaling s(t) 0..1: ramp Ta at a_s, cruise at v_s = 1 / c with
+    // c = T - Ta. Joint i moves d_i * s(t), so it needs
+    //   c >= d_i / vmax_i and c * Ta >= d_i / amax_i
+    // The shortest T = c + Ta satisfying the worst joint of both:
+    float V = 0.0f, A = 0.0f;
+    for (int i = 0; i < NUM_SERVOS; i++)
+    {
+        jointMove.start[i] = (float)currentUs[i]; // Where the servo is, or stops
+        jointMove.delta[i] = 0.0f;
+        if (!(mask & (1 << i)))
+            continue;
+        int us = targetUs[i];
+        us = us < servos[i].minUs ? servos[i].minUs : (us > servos[i].maxUs ? servos[i].maxUs : us);
+        jointMove.delta[i] = us - jointMove.start[i];
+        float d = fabsf(jointMove.delta[i]);
+        float v = servos[i].maxVelUsS * speed;
+        float a = servos[i].maxAccUsS2 * speed * speed;
+        if (v > 0.0f && d / v > V)
+            V = d / v;
+        if (a > 0.0f && d / a > A)
+            A = d / a;
+    }
+    float c, ramp;
+    if (V * V >= A)
+    {
+        c = V; // Reaches cruise speed
+        ramp = V > 0.0f ? A / V : 0.0f;
+    }
+    else
+    {
+        c = sqrtf(A); // Triangle, accelerate then brake
+        ramp = c;
+    }
+
+    jointMove.mask = mask;
+    jointMove.durationMs = (c + ramp) * 1000.0f;
+    jointMove.rampMs = ramp * 1000.0f;
+    jointMove.startTime = halMillis();
+    jointMove.active = true;
+    jointMove.waiting = !settled;
+    profileBypassMask = settled ? mask : 0;
+    return jointMove.durationMs;
+}
+
+IkProjection startJointMoveToXYZ(float x, float y, float z, float pitch_deg, bool relaxPitch, float speed)
+{
+    int target[4];
+    IkProjection proj;
+    inverseKinematicsNearest(x, y, z, pitch_deg, relaxPitch, target, proj, currentUs);
+    ikReachable = !proj.projected && !proj.pitchRelaxed;
+    ikErrorCm = proj.errorCm;
+    if (proj.projected)
+        halLog("IK Target Unreachable, moving to nearest reachable pose");
+
+    int us[NUM_SERVOS] = {target[0], target[1], target[2], target[3], currentUs[4]};
+    startJointMove(us, 0x0F, speed);
+    return proj;
+}
+
+void stopJointMove()
+{
+    // The output profile takes over from the current command
+    jointMove.active = false;
+    profileBypassMask = 0;
+}
+
+float timeScaling(float t, float T, float Ta)
+{
+    if (t >= T || T <= 0.0f)
+        return 1.0f;
+    float c = T - Ta;
+    if (Ta <= 0.0f)
+        return t / T;
+    float acc = 1.0f / (c * Ta); // per ms^2
+    if (t < Ta)
+        return 0.5f * acc * t * t;
+    if (t > c)
+        return 1.0f - 0.5f * acc * (T - t) * (T - t);
+    return 0.5f * Ta / c + (t - Ta) / c;
+}
+
+void jointMotionTick()
+{
+    if (!jointMove.active)
+        return;
+    if (jointMove.waiting)
+    {
+        if (!servosSettled(jointMove.mask))
+            return;
+        jointMove.waiting = false;
+        jointMove.startTime = halMillis();
+        profileBypassMask = jointMove.mask;
+    }
+
+    float t = (float)(halMillis() - jointMove.startTime);
+    float s = timeScaling(t, jointMove.durationMs, jointMove.rampMs);
+    for (int i = 0; i < NUM_SERVOS; i++)
+    {
+        if (jointMove.mask & (1 << i))
+            moveServoUs(i, (int)lroundf(jointMove.start[i] + jointMove.delta[i] * s));
+    }
+    if (t >= jointMove.durationMs)
+        stopJointMove(); // Arrived, outputs are on the targets
+}
@@ -0,0 +1,177 @@
+#include "keyframes.h"
+#include "arm_config.h"
+#include "servo_cal_data.h"
+#include <math.h>
+#include <vector>
+
+struct KeyframeSpan
+{
+    uint16_t a;
+    uint16_t b;
+};
+
+static void jointsOf(const RecordedStep &s, float *v)
+{
+    v[0] = s.base;
+    v[1] = s.shoulder;
+    v[2] = s.elbow;
+    v[3] = s.wrist;
+    v[4] = s.gripper;
+}
+
+float keyframeUnitUs(int servoIndex, KeyframeUnit unit)
+{
+    float percentUs = (servos[servoIndex].maxUs - servos[servoIndex].minUs) / 100.0f;
+    if (unit == KEYFRAME_PERCENT || servoIndex >= SERVO_CAL_SERVOS)
+        return percentUs;
+    // Steepest segment of the calibration: a degree anywhere is at least this many us
+    float usStep = (float)(SERVO_CAL_MAX_US[servoIndex] - SERVO_CAL_MIN_US[servoIndex]) / (SERVO_CAL_POINTS - 1);
+    float maxDeg = 0;
+    for (int k = 0; k + 1 < SERVO_CAL_POINTS; k++)
+    {
+        float d = fabsf(SERVO_CAL_ANGLE[servoIndex][k + 1] - SERVO_CAL_ANGLE[servoIndex][k]);
+        maxDeg = d > maxDeg ? d : maxDeg;
+    }
+    return maxDeg > 0 ? usStep / maxDeg : percentUs; // Gripper: no angle
+}
+
+// Marks the rows of one window to keep. Iterative, the split stack is a
+// vector instead of the call stack.
+static void simplifyWindow(const std::vector<RecordedStep> &rows, const std::vector<uint32_t> &times,
+                           const float *invTol, std::vector<uint8_t> &keep, std::vector<KeyframeSpan> &stack)
+{
+    size_t n = rows.size();
+    keep.assign(n, 0);
+    keep[0] = 1;
+    keep[n - 1] = 1;
+    stack.clear();
+    if (n > 2)
+        stack.push_back({0, (uint16_t)(n - 1)});
+    while (!stack.empty())
+    {
+        KeyframeSpan s = stack.back();
+        stack.pop_back();
+        float a[RECORDING_JOINTS], b[RECORDING_JOINTS], v[RECORDING_JOINTS];
+        jointsOf(rows[s.a], a);
+        jointsOf(rows[s.b], b);
+        float span = (float)(times[s.b] - times[s.a]);
+
+        // Worst row against the chord at its own time, 1 = on the tolerance
+        float worst = 1.0f;
+        size_t at = 0;
+        for (size_t i = s.a + 1; i < s.b; i++)
+        {
+            float f = span > 0 ? (times[i] - times[s.a]) / span : 0.0f;
+            jointsOf(rows[i], v);
+            for (int j = 0; j < RECORDING_JOINTS; j++)
+            {
+                float e = fabsf(v[j] - (a[j] + (b[j] - a[j]) * f)) * invTol[j];
+                if (e > worst)
+                {
+                    worst = e;
+                    at = i;
+                }
+            }
+        }
+        if (!at)
+            continue;
+        keep[at] = 1;
+        if (at - s.a > 1)
+            stack.push_back({s.a, (uint16_t)at});
+        if (s.b - at > 1)
+            stack.push_back({(uint16_t)at, s.b});
+    }
+}
+
+// Every row of in against out played back by PLAYBACK_INTERPOLATE
+static float playedDeviation(const Recording &in, const Recording &out, const float *unitUs)
+{
+    Recording::Cursor src = in.cursor();
+    Recording::Cursor key = out.cursor();
+    RecordedStep step, from, to;
+    bool hasTo = key.next(to);
+    uint32_t fromMs = 0, toMs = key.timeMs();
+    from = to;
+    float worst = 0;
+    float v[RECORDING_JOINTS], a[RECORDING_JOINTS], b[RECORDING_JOINTS];
+    while (src.next(step))
+    {
+        uint32_t t = src.timeMs();
+        while (hasTo && toMs <= t)
+        {
+            from = to;
+            fromMs = toMs;
+            hasTo = key.next(to);
+            toMs = key.timeMs();
+        }
+        float f = hasTo ? (float)(t - fromMs) / (float)(toMs - fromMs) : 0.0f;
+        jointsOf(step, v);
+        jointsOf(from, a);
+        jointsOf(to, b);
+        for (int j = 0; j < RECORDING_JOINTS; j++)
+        {
+            float played = hasTo ? lroundf(a[j] + (b[j] - a[j]) * f) : a[j];
+            float e = fabsf(v[j] - played) / unitUs[j];
+            worst = e > worst ? e : worst;
+        }
+    }
+    return worst;
+}
+
+KeyframeResult simplifyRecording(const Recording &in, Recording &out, float tolerance, KeyframeUnit unit)
+{
+    // Rows are whole us and playback rounds, half a us is always allowed
+    float unitUs[RECORDING_JOINTS], invTol[RECORDING_JOINTS];
+    for (int j = 0; j < RECORDING_JOINTS; j++)
+    {
+        unitUs[j] = keyframeUnitUs(j, unit);
+        float tolUs = tolerance * unitUs[j];
+        invTol[j] = 1.0f / (tolUs > 0.5f ? tolUs : 0.5f);
+    }
+
+    out.clear();
+    out.setTimeTolerance(0); // Keyframe times are the durations, keep them exact
+    std::vector<RecordedStep> rows;
+    std::vector<uint32_t> times;
+    std::vector<uint8_t> keep;
+    std::vector<KeyframeSpan> stack;
+    rows.reserve(KEYFRAME_WINDOW);
+    times.reserve(KEYFRAME_WINDOW);
+
+    KeyframeResult result = {in.size(), 0, in.bytes(), 0, 0.0f, true, false};
+    Recording::Cursor cursor = in.cursor();
+    RecordedStep step;
+    bool more = cursor.next(step);
+    if (more)
+    {
+        rows.push_back(step);
+        times.push_back(cursor.timeMs());
+    }
+    size_t written = 0; // Rows at the start of the window already in out
+    while (!rows.empty() && result.complete)
+    {
+        while (rows.size() < KEYFRAME_WINDOW && (more = cursor.next(step)))
+        {
+            rows.push_back(step);
+            times.push_back(cursor.timeMs());
+        }
+        simplifyWindow(rows, times, invTol, keep, stack);
+        for (size_t i = written; i < rows.size() && result.complete; i++)
+        {
+            if (keep[i])
+                result.complete = out.append(rows[i], times[i]);
+        }
+        if (!more)
+            break;
+        // The window's last row starts the next one
+        rows.erase(rows.begin(), rows.end() - 1);
+        times.erase(times.begin(), times.end() - 1);
+        written = 1;
+    }
+
+    result.rowsOut = out.size();
+    result.bytesOut = out.bytes();
+    result.smaller = result.bytesOut < result.bytesIn;
+    result.maxDeviation = playedDeviation(in, out, unitUs);
+    return result;
+}
@@ -0,0 +1,576 @@
+#include "kinematics.h"
+#include "fast_math.h"
+#include "servo_cal_data.h"
+
+// All math in here is single precision (see fast_math.h), the double
+// precision originals live in kinematics_ref.cpp for comparison.
+
+float mapFloat(float x, float in_min, float in_max, float out_min, float out_max)
+{
+    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+int angleToPercent(int servoIndex, float angle)
+{
+    const ServoConfig &cfg = servos[servoIndex];
+    // Reverse logic of mapFloat: (angle - out_min) / (out_max - out_min) could work but mapFloat is generic.
+    // percent = (angle - angle0) * 100 / (angle100 - angle0)
+    // Note: angle0 corresponds to 0%, angle100 to 100%
+    float p = (angle - cfg.angle0) * 100.0f / (cfg.angle100 - cfg.angle0);
+    return (int)p;
+}
+
+// --- JOINT UNITS ---
+// Angle <-> pulse width goes through the per-servo calibration table
+// (include/servo_cal_data.h, fitted by tools/fit_servo_cal.py): knots evenly
+// spaced in us, so usToAngle() finds its segment with one multiply. Slopes
+// are computed at compile time so neither direction divides.
+static_assert(SERVO_CAL_SERVOS == NUM_SERVOS, "servo_cal_data.h is out of date, re-run tools/fit_servo_cal.py");
+
+constexpr bool calibrationMatchesServos()
+{
+    for (int i = 0; i < NUM_SERVOS; i++)
+        if (SERVO_CAL_MIN_US[i] != servos[i].minUs || SERVO_CAL_MAX_US[i] != servos[i].maxUs)
+            return false;
+    return true;
+}
+static_assert(calibrationMatchesServos(), "servo_cal_data.h was fitted for other servo ranges, re-run tools/fit_servo_cal.py");
+
+struct JointCal
+{
+    float us0;
+    float usStep;
+    float invUsStep;
+    float invAngleStep;                    // Segment guess for angleToUs()
+    bool rising;                           // Angle grows with the pulse
+    float slope[SERVO_CAL_POINTS - 1];     // deg/us per segment
+    float invSlope[SERVO_CAL_POINTS - 1];  // us/deg per segment, 0 if flat
+};
+
+struct JointScale
+{
+    float degPerUs[NUM_SERVOS]; // End to end, for travel estimates
+    JointCal cal[NUM_SERVOS];
+};
+
+static constexpr JointScale computeJointScale()
+{
+    JointScale js{};
+    const int segments = SERVO_CAL_POINTS - 1;
+    for (int i = 0; i < NUM_SERVOS; i++)
+    {
+        const float *angle = SERVO_CAL_ANGLE[i];
+        JointCal &c = js.cal[i];
+        c.us0 = (float)SERVO_CAL_MIN_US[i];
+        c.usStep = (float)(SERVO_CAL_MAX_US[i] - SERVO_CAL_MIN_US[i]) / segments;
+        c.invUsStep = 1.0f / c.usStep;
+        float spanDeg = angle[segments] - angle[0];
+        c.invAngleStep = spanDeg != 0.0f ? segments / spanDeg : 0.0f;
+        c.rising = spanDeg >= 0.0f;
+        for (int k = 0; k < segments; k++)
+        {
+            float d = angle[k + 1] - angle[k];
+            c.slope[k] = d * c.invUsStep;
+            c.invSlope[k] = d != 0.0f ? c.usStep / d : 0.0f;
+        }
+        js.degPerUs[i] = spanDeg / (SERVO_CAL_MAX_US[i] - SERVO_CAL_MIN_US[i]);
+    }
+    return js;
+}
+
+static constexpr JointScale jointScale = computeJointScale();
+
+// Outside the table the end segments are extended
+static inline int clampSegment(int k)
+{
+    return k < 0 ? 0 : (k > SERVO_CAL_POINTS - 2 ? SERVO_CAL_POINTS - 2 : k);
+}
+
+float usToAngle(int servoIndex, float us)
+{
+    const JointCal &c = jointScale.cal[servoIndex];
+    float t = (us - c.us0) * c.invUsStep;
+    int k = clampSegment(t < 0.0f ? -1 : (int)t);
+    return SERVO_CAL_ANGLE[servoIndex][k] + (us - (c.us0 + k * c.usStep)) * c.slope[k];
+}
+
+float angleToUs(int servoIndex, float angle)
+{
+    const JointCal &c = jointScale.cal[servoIndex];
+    const float *a = SERVO_CAL_ANGLE[servoIndex];
+    // The table is monotonic: guess the segment as if it were linear, then
+    // walk (a calibrated servo is never off by more than a segment or two)
+    float t = (angle - a[0]) * c.invAngleStep;
+    int k = clampSegment(t < 0.0f ? -1 : (int)t);
+    if (c.rising)
+    {
+        while (k < SERVO_CAL_POINTS - 2 && angle > a[k + 1])
+            k++;
+        while (k > 0 && angle < a[k])
+            k--;
+    }
+    else
+    {
+        while (k < SERVO_CAL_POINTS - 2 && angle < a[k + 1])
+            k++;
+        while (k > 0 && angle > a[k])
+            k--;
+    }
+    return c.us0 + k * c.usStep + (angle - a[k]) * c.invSlope[k];
+}
+
+// Integer map of every whole percent, like Arduino map()
+struct PercentTable
+{
+    uint16_t us[NUM_SERVOS][101];
+    constexpr PercentTable() : us()
+    {
+        for (int i = 0; i < NUM_SERVOS; i++)
+            for (int p = 0; p <= 100; p++)
+                us[i][p] = (uint16_t)(p * (servos[i].maxUs - servos[i].minUs) / 100 + servos[i].minUs);
+    }
+};
+static constexpr PercentTable percentTable;
+
+int percentToUs(int servoIndex, int percent)
+{
+    if (percent >= 0 && percent <= 100)
+        return percentTable.us[servoIndex][percent];
+    const ServoConfig &cfg = servos[servoIndex];
+    return percent * (cfg.maxUs - cfg.minUs) / 100 + cfg.minUs;
+}
+
+float usToPercent(int servoIndex, float us)
+{
+    const ServoConfig &cfg = servos[servoIndex];
+    return (us - cfg.minUs) * 100.0f / (cfg.maxUs - cfg.minUs);
+}
+
+// --- FORWARD KINEMATICS ---
+Coord forwardKinematics(const int *us)
+{
+    // 1. Convert Pulse Widths to Physical Angles (radians)
+    float t1_rad = usToAngle(0, us[0]) * DEG_TO_RAD_F;
+    float t2_rad = usToAngle(1, us[1]) * DEG_TO_RAD_F;
+    float gamma_rad = usToAngle(2, us[2]) * DEG_TO_RAD_F;
+    float wristServo = usToAngle(3, us[3]);
+
+    // 2. Global Angles
+    // Shoulder Angle: 0 = Horizontal Forward, 90 = Up.
+
+    // Elbow Global (relative to horizon)
+    float elbow_global_rad = t2_rad - (PI_F - gamma_rad);
+
+    // Wrist Global (Pitch)
+    float wrist_deviation_rad = (wristServo - 180.0f) * DEG_TO_RAD_F;
+    float pitch_rad = elbow_global_rad + wrist_deviation_rad;
+
+    // 3. Coordinates
+    float s1, c1, s2, c2, se, ce, sp, cp;
+    fastSinCos(t1_rad, s1, c1);
+    fastSinCos(t2_rad, s2, c2);
+    fastSinCos(elbow_global_rad, se, ce);
+    fastSinCos(pitch_rad, sp, cp);
+
+    float R = L2 * c2 + L3 * ce + L4 * cp;
+    float Z = L1 + L2 * s2 + L3 * se + L4 * sp;
+
+    float X = R * c1;
+    float Y = R * s1;
+
+    return {X, Y, Z, pitch_rad * RAD_TO_DEG_F};
+}
+
+// --- JACOBIAN ---
+float fkJacobian(const float *q, float J[4][4])
+{
+    // Same chain as forwardKinematics():
+    //   e = shoulder - (PI - elbow), p = e + (wrist - PI)
+    //   R = L2 cos(shoulder) + L3 cos(e) + L4 cos(p)
+    //   Z = L1 + L2 sin(shoulder) + L3 sin(e) + L4 sin(p)
+    //   X = R cos(base), Y = R sin(base), pitch = p
+    float e = q[1] - (PI_F - q[2]);
+    float p = e + (q[3] - PI_F);
+    float s1, c1, s2, c2, se, ce, sp, cp;
+    fastSinCos(q[0], s1, c1);
+    fastSinCos(q[1], s2, c2);
+    fastSinCos(e, se, ce);
+    fastSinCos(p, sp, cp);
+
+    float R = L2 * c2 + L3 * ce + L4 * cp;
+
+    // dR and dZ over shoulder, elbow, wrist (each joint moves everything after it)
+    float dR[3] = {-L2 * s2 - L3 * se - L4 * sp, -L3 * se - L4 * sp, -L4 * sp};
+    float dZ[3] = {L2 * c2 + L3 * ce + L4 * cp, L3 * ce + L4 * cp, L4 * cp};
+
+    J[0][0] = -R * s1;
+    J[1][0] = R * c1;
+    J[2][0] = 0.0f;
+    J[3][0] = 0.0f;
+    for (int j = 0; j < 3; j++)
+    {
+        J[0][j + 1] = dR[j] * c1;
+        J[1][j + 1] = dR[j] * s1;
+        J[2][j + 1] = dZ[j];
+        J[3][j + 1] = 1.0f;
+    }
+
+    // Rotating the x/y rows into radial/tangential leaves det unchanged:
+    // det J = -R * det[dR; dZ; 1 1 1]
+    float det3 = dR[0] * (dZ[1] - dZ[2]) - dR[1] * (dZ[0] - dZ[2]) + dR[2] * (dZ[0] - dZ[1]);
+    return fabsf(R * det3);
+}
+
+// --- INVERSE KINEMATICS ---
+// Reach of the L2-L3 triangle (wrist center distance from the shoulder).
+// Bounded by the elbow's included angle range, not just L2 +/- L3, so
+// everything inside the annulus is reachable without clamping the elbow.
+struct ReachLimits
+{
+    float minD;
+    float maxD;
+};
+
+static ReachLimits computeReach()
+{
+    // Table ends, the calibration is monotonic
+    float g0 = usToAngle(2, servos[2].minUs);
+    float g1 = usToAngle(2, servos[2].maxUs);
+    float gMin = (g0 < g1 ? g0 : g1) * DEG_TO_RAD_F;
+    float gMax = (g0 < g1 ? g1 : g0) * DEG_TO_RAD_F;
+    if (gMin < 0.0f)
+        gMin = 0.0f;
+    if (gMax > PI_F)
+        gMax = PI_F;
+    // D^2 = L2^2 + L3^2 - 2 L2 L3 cos(gamma)
+    return {sqrtf(L2 * L2 + L3 * L3 - 2.0f * L2 * L3 * fastCos(gMin)),
+            sqrtf(L2 * L2 + L3 * L3 - 2.0f * L2 * L3 * fastCos(gMax))};
+}
+
+static const ReachLimits &reach()
+{
+    static const ReachLimits limits = computeReach();
+    return limits;
+}
+
+// --- IK BRANCHES ---
+// Every FK solution for a tip: base direct or turned 180 deg (reaching over
+// the top, tip at -R in the arm plane), each with the elbow up or down.
+// A branch only counts if every joint lies inside its servos[] range, so
+// moveServo never has to clamp (and distort) an IK result.
+
+bool angleToUsInRange(int servoIndex, float angle_deg, float &us)
+{
+    const float EPS = 0.02f; // us
+    const ServoConfig &cfg = servos[servoIndex];
+    for (int k = 0; k < 3; k++)
+    {
+        float a = angle_deg + (k == 0 ? 0.0f : (k == 1 ? 360.0f : -360.0f));
+        float u = angleToUs(servoIndex, a);
+        if (u >= cfg.minUs - EPS && u <= cfg.maxUs + EPS)
+        {
+            us = u < cfg.minUs ? cfg.minUs : (u > cfg.maxUs ? cfg.maxUs : u);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Joint angles (deg) of both elbow branches for a tip at (Rfk, Z_arm) in the
+// arm plane: angles[0] elbow up, angles[1] elbow down, each {shoulder, elbow,
+// wrist}. The triangle and its trig are shared. Only checks the L2-L3
+// triangle, not the servo ranges.
+static bool solveElbows(float Rfk, float Z_arm, float sp, float cp, float pitch_rad, float angles[2][3])
+{
+    float wr = Rfk - L4 * cp;
+    float wz = Z_arm - L4 * sp;
+
+    // 3. Triangle L2-L3 to Reach (wr, wz)
+    float D_sq = wr * wr + wz * wz;
+    float D = sqrtf(D_sq);
+    if (D > L2 + L3 || D < fabsf(L2 - L3) || D < 1e-6f)
+        return false;
+
+    // Law of Cosines for Shoulder (Alpha), fastAcos clamps to [-1, 1]
+    float alpha_rad = fastAcos((D_sq + L2 * L2 - L3 * L3) / (2.0f * D * L2));
+    float phi_rad = fastAtan2(wz, wr);
+
+    // Law of Cosines for Elbow (Gamma - included angle)
+    float gamma_rad = fastAcos((L2 * L2 + L3 * L3 - D_sq) / (2.0f * L2 * L3));
+
+    for (int b = 0; b < 2; b++)
+    {
+        // Elbow UP: shoulder above the wrist line. Elbow DOWN mirrors the
+        // triangle, the elbow servo then sees the reflex angle 360 - gamma.
+        float theta2_rad = b == 0 ? phi_rad + alpha_rad : phi_rad - alpha_rad;
+        float elbow_rad = b == 0 ? gamma_rad : 2.0f * PI_F - gamma_rad;
+
+        // Wrist Servo
+        // FK: pitch = elbow_global + (wrist_servo - 180), elbow_global = theta2 - (180 - gamma)
+        // => wrist_servo = pitch - elbow_global + 180
+        float elbow_global_rad = theta2_rad - (PI_F - elbow_rad);
+        float wrist_servo_rad = pitch_rad - elbow_global_rad + PI_F;
+
+        angles[b][0] = theta2_rad * RAD_TO_DEG_F;
+        angles[b][1] = elbow_rad * RAD_TO_DEG_F;
+        angles[b][2] = wrist_servo_rad * RAD_TO_DEG_F;
+    }
+    return true;
+}
+
+// Largest joint move (deg) from the current pose, settling time follows it
+static float jointTravel(const float *us, const int *current)
+{
+    float worst = 0.0f;
+    for (int i = 0; i < 4; i++)
+    {
+        float deg = fabsf((us[i] - current[i]) * jointScale.degPerUs[i]);
+        if (deg > worst)
+            worst = deg;
+    }
+    return worst;
+}
+
+// Best in-range branch for a tip given by base angle, arm-plane distance R
+// (>= 0), height above the shoulder and pitch. Without a current pose the
+// first valid branch wins (direct base, elbow up first).
+static bool solvePlanar(float theta1_deg, float R, float Z_arm, float pitch_rad, const int *current, int *us)
+{
+    bool found = false;
+    float bestTravel = 0.0f;
+    float best[4];
+    float sp, cp;
+    fastSinCos(pitch_rad, sp, cp);
+
+    for (int flip = 0; flip < 2 && !(found && !current); flip++)
+    {
+        float base;
+        float angles[2][3];
+        if (!angleToUsInRange(0, flip ? theta1_deg + 180.0f : theta1_deg, base) ||
+            !solveElbows(flip ? -R : R, Z_arm, sp, cp, pitch_rad, angles))
+            continue;
+
+        for (int b = 0; b < 2; b++)
+        {
+            float joint[4];
+            joint[0] = base;
+            if (!angleToUsInRange(1, angles[b][0], joint[1]) ||
+                !angleToUsInRange(2, angles[b][1], joint[2]) ||
+                !angleToUsInRange(3, angles[b][2], joint[3]))
+                continue;
+
+            float travel = current ? jointTravel(joint, current) : 0.0f;
+            if (!found || travel < bestTravel)
+            {
+                found = true;
+                bestTravel = travel;
+                for (int i = 0; i < 4; i++)
+                    best[i] = joint[i];
+            }
+            if (!current)
+                break;
+        }
+    }
+
+    if (!found)
+        return false;
+    // Round, don't truncate: whole microseconds are the output resolution
+    for (int i = 0; i < 4; i++)
+        us[i] = (int)(best[i] + 0.5f);
+    return true;
+}
+
+// Direct elbow-up solution with every joint clamped to its servo range.
+// Only used as the last resort of inverseKinematicsNearest().
+static bool solveClamped(float theta1_deg, float R, float Z_arm, float pitch_rad, int *us)
+{
+    float sp, cp;
+    float angles[2][3];
+    fastSinCos(pitch_rad, sp, cp);
+    if (!solveElbows(R, Z_arm, sp, cp, pitch_rad, angles))
+        return false;
+    float joint[4] = {angleToUs(0, theta1_deg), angleToUs(1, angles[0][0]), angleToUs(2, angles[0][1]),
+                      angleToUs(3, angles[0][2])};
+    for (int i = 0; i < 4; i++)
+    {
+        float u = joint[i];
+        u = u < servos[i].minUs ? servos[i].minUs : (u > servos[i].maxUs ? servos[i].maxUs : u);
+        us[i] = (int)lroundf(u);
+    }
+    return true;
+}
+
+bool inverseKinematics(float x, float y, float z, float pitch_deg, int *us, const int *current)
+{
+    // 1. Base (Theta 1)
+    float theta1 = fastAtan2(y, x) * RAD_TO_DEG_F;
+
+    // 2. Wrist Center
+    float R = sqrtf(x * x + y * y);
+    // Singularity protection (near origin)
+    if (R < 0.1f)
+        R = 0.1f;
+
+    float Z_arm = z - L1; // Height relative to shoulder
+
+    return solvePlanar(theta1, R, Z_arm, pitch_deg * DEG_TO_RAD_F, current, us);
+}
+
+// Base direct, elbow up, no range check: the work inverseKinematicsRef()
+// does, for the benchmark
+bool inverseKinematicsElbowUp(float x, float y, float z, float pitch_deg, int *us)
+{
+    float theta1 = fastAtan2(y, x) * RAD_TO_DEG_F;
+    float R = sqrtf(x * x + y * y);
+    if (R < 0.1f)
+        R = 0.1f;
+
+    float pitch_rad = pitch_deg * DEG_TO_RAD_F;
+    float sp, cp;
+    float angles[2][3];
+    fastSinCos(pitch_rad, sp, cp);
+    if (!solveElbows(R, z - L1, sp, cp, pitch_rad, angles))
+        return false;
+    us[0] = (int)(angleToUs(0, theta1) + 0.5f);
+    for (int i = 1; i < 4; i++)
+        us[i] = (int)(angleToUs(i, angles[0][i - 1]) + 0.5f);
+    return true;
+}
+
+// --- NEAREST REACHABLE ---
+// Wraps an angle to [-PI, PI]
+static float wrapAngle(float a)
+{
+    while (a > PI_F)
+        a -= 2.0f * PI_F;
+    while (a < -PI_F)
+        a += 2.0f * PI_F;
+    return a;
+}
+
+// Closest pitch to the requested one that puts the wrist center inside the
+// reach annulus for a fixed tip (R, Z_arm). The wrist center lies on a circle
+// of radius L4 around the tip, so |W|^2 = dT^2 + L4^2 - 2 dT L4 cos(p - phiT)
+// and each reach limit bounds |p - phiT| by an acos.
+static bool relaxPitch(float R, float Z_arm, float pitch_rad, float &relaxed)
+{
+    const float MARGIN = 1e-3f; // rad, keeps the result strictly inside
+    const float REACH_MAX = reach().maxD;
+    const float REACH_MIN = reach().minD;
+    float dT = sqrtf(R * R + Z_arm * Z_arm);
+    if (dT < 1e-4f)
+        return false;
+    float phiT = fastAtan2(Z_arm, R);
+    float off = wrapAngle(pitch_rad - phiT);
+
+    // |W| <= REACH_MAX  <=>  cos(off) >= cMax
+    float cMax = (dT * dT + L4 * L4 - REACH_MAX * REACH_MAX) / (2.0f * dT * L4);
+    if (cMax > 1.0f)
+        return false; // Tip too far for any pitch
+    if (cMax > -1.0f)
+    {
+        float half = fastAcos(cMax) - MARGIN;
+        if (half < 0.0f)
+            return false;
+        if (off > half)
+            off = half;
+        if (off < -half)
+            off = -half;
+    }
+
+    // |W| >= REACH_MIN  <=>  cos(off) <= cMin
+    float cMin = (dT * dT + L4 * L4 - REACH_MIN * REACH_MIN) / (2.0f * dT * L4);
+    if (cMin < -1.0f)
+        return false; // Tip too close for any pitch
+    if (cMin < 1.0f)
+    {
+        float lo = fastAcos(cMin) + MARGIN;
+        if (fabsf(off) < lo)
+            off = off < 0.0f ? -lo : lo;
+    }
+
+    relaxed = phiT + off;
+    return true;
+}
+
+void inverseKinematicsNearest(float x, float y, float z, float pitch_deg, bool allowPitchRelax,
+                              int *us, IkProjection &proj, const int *current)
+{
+    proj = {{x, y, z, pitch_deg}, 0.0f, false, false};
+
+    float theta1_rad = fastAtan2(y, x);
+    float theta1 = theta1_rad * RAD_TO_DEG_F;
+    float R = sqrtf(x * x + y * y);
+    if (R < 0.1f)
+        R = 0.1f;
+    float Z_arm = z - L1;
+
+    float pitch_rad = pitch_deg * DEG_TO_RAD_F;
+    if (solvePlanar(theta1, R, Z_arm, pitch_rad, current, us))
+        return; // Exact
+
+    // 1. Keep the tip, change the pitch
+    float relaxed;
+    if (allowPitchRelax && relaxPitch(R, Z_arm, pitch_rad, relaxed) &&
+        solvePlanar(theta1, R, Z_arm, relaxed, current, us))
+    {
+        proj.reached.pitch = relaxed * RAD_TO_DEG_F;
+        proj.pitchRelaxed = true;
+        return;
+    }
+
+    // 2. Pull the wrist center radially onto the reach shell, the tip moves by
+    // exactly as much as the wrist center. If the pitch may change, pointing
+    // it at the target first gives the smallest error for far targets.
+    const float REACH_MAX = reach().maxD;
+    const float REACH_MIN = reach().minD;
+    float sp, cp;
+    fastSinCos(pitch_rad, sp, cp);
+    float wr = R - L4 * cp;
+    float wz = Z_arm - L4 * sp;
+    float D = sqrtf(wr * wr + wz * wz);
+    if (allowPitchRelax && D > REACH_MAX)
+    {
+        pitch_rad = fastAtan2(Z_arm, R);
+        fastSinCos(pitch_rad, sp, cp);
+        wr = R - L4 * cp;
+        wz = Z_arm - L4 * sp;
+        D = sqrtf(wr * wr + wz * wz);
+        proj.pitchRelaxed = true;
+    }
+
+    float Dt = D;
+    if (D > REACH_MAX)
+        Dt = REACH_MAX - 1e-4f;
+    else if (D < REACH_MIN)
+        Dt = REACH_MIN + 1e-4f;
+    float ur = 1.0f, uz = 0.0f;
+    if (D > 1e-6f)
+    {
+        ur = wr / D;
+        uz = wz / D;
+    }
+    float nwr = ur * Dt;
+    float nwz = uz * Dt;
+    float nR = nwr + L4 * cp;
+    float nZ = nwz + L4 * sp;
+
+    proj.projected = true;
+    if (nR >= 0.0f && solvePlanar(theta1, nR, nZ, pitch_rad, current, us))
+    {
+        float s1, c1;
+        fastSinCos(theta1_rad, s1, c1);
+        proj.reached = {nR * c1, nR * s1, nZ + L1, pitch_rad * RAD_TO_DEG_F};
+        proj.errorCm = sqrtf((nwr - wr) * (nwr - wr) + (nwz - wz) * (nwz - wz));
+        return;
+    }
+
+    // Shell point outside a base/shoulder/wrist range: fall back to the
+    // clamped solution and report where the clamped joints actually end up
+    solveClamped(theta1, nR, nZ, pitch_rad, us);
+    proj.reached = forwardKinematics(us);
+    float dx = proj.reached.x - x;
+    float dy = proj.reached.y - y;
+    float dz = proj.reached.z - z;
+    proj.errorCm = sqrtf(dx * dx + dy * dy + dz * dz);
+}
@@ -0,0 +1,230 @@
+// Double precision kinematics as originally written (cos/sin/atan2/acos, PI,
+// radians()/degrees()). Not used for control any more, only kept as the
+// accuracy and cycle-count reference for the kernels in kinematics.cpp, so
+// the joints go through the same calibration (usToAngle()/angleToUs()).
+
+#include "kinematics.h"
+#include "fast_math.h"
+#include "hal.h"
+#include <math.h>
+#include <stdlib.h>
+
+// Same definitions as Arduino.h so host builds compute identical results
+#ifndef PI
+#define PI 3.1415926535897932384626433832795
+#endif
+#ifndef radians
+#define radians(deg) ((deg) * 0.017453292519943295769236907684886)
+#endif
+#ifndef degrees
+#define degrees(rad) ((rad) * 57.295779513082320876798154814105)
+#endif
+
+// --- FORWARD KINEMATICS ---
+Coord forwardKinematicsRef(const int *us)
+{
+    // 1. Convert Pulse Widths to Physical Angles
+    float theta1 = usToAngle(0, us[0]);
+    float theta2 = usToAngle(1, us[1]);
+    float gamma = usToAngle(2, us[2]);
+    float wristServo = usToAngle(3, us[3]);
+
+    // 2. Degrees to Radians
+    float t1_rad = radians(theta1);
+    float t2_rad = radians(theta2);
+    float gamma_rad = radians(gamma);
+
+    // 3. Global Angles
+    // Shoulder Angle: 0 = Horizontal Forward, 90 = Up.
+
+    // Elbow Global (relative to horizon)
+    float elbow_global_rad = t2_rad - (PI - gamma_rad);
+
+    // Wrist Global (Pitch)
+    float wrist_deviation_rad = radians(wristServo - 180.0);
+    float pitch_rad = elbow_global_rad + wrist_deviation_rad;
+
+    // 4. Coordinates
+    float R = L2 * cos(t2_rad) + L3 * cos(elbow_global_rad) + L4 * cos(pitch_rad);
+    float Z = L1 + L2 * sin(t2_rad) + L3 * sin(elbow_global_rad) + L4 * sin(pitch_rad);
+
+    float X = R * cos(t1_rad);
+    float Y = R * sin(t1_rad);
+
+    return {X, Y, Z, (float)degrees(pitch_rad)};
+}
+
+// --- INVERSE KINEMATICS ---
+bool inverseKinematicsRef(float x, float y, float z, float pitch_deg, int *us)
+{
+    // 1. Base (Theta 1)
+    // atan2(y, x).
+    float theta1 = degrees(atan2(y, x));
+
+    // 2. Wrist Center
+    float R = sqrt(x * x + y * y);
+    // Singularity protection (near origin)
+    if (R < 0.1)
+        R = 0.1;
+
+    float Z_arm = z - L1; // Height relative to shoulder
+
+    // Wrist joint position
+    float pitch_rad = radians(pitch_deg);
+    float wr = R - L4 * cos(pitch_rad);
+    float wz = Z_arm - L4 * sin(pitch_rad);
+
+    // 3. Triangle L2-L3 to Reach (wr, wz)
+    float D_sq = wr * wr + wz * wz;
+    float D = sqrt(D_sq);
+
+    if (D > (L2 + L3) || D < fabs(L2 - L3))
+        return false;
+
+    // Law of Cosines for Shoulder (Alpha)
+    float c_alpha = (D_sq + L2 * L2 - L3 * L3) / (2 * D * L2);
+    // Clamp
+    if (c_alpha > 1.0)
+        c_alpha = 1.0;
+    if (c_alpha < -1.0)
+        c_alpha = -1.0;
+    float alpha_rad = acos(c_alpha);
+
+    float phi_rad = atan2(wz, wr);
+    float theta2_rad = phi_rad + alpha_rad; // Elbow UP solution
+    float theta2 = degrees(theta2_rad);
+
+    // Law of Cosines for Elbow (Gamma - included angle)
+    float c_gamma = (L2 * L2 + L3 * L3 - D_sq) / (2 * L2 * L3);
+    if (c_gamma > 1.0)
+        c_gamma = 1.0;
+    if (c_gamma < -1.0)
+        c_gamma = -1.0;
+    float gamma_rad = acos(c_gamma);
+    float gamma = degrees(gamma_rad);
+
+    // Wrist Servo
+    // FK Logic was: pitch = theta2 - (180 - gamma) + (servo - 180)
+    // pitch_rad = theta2_rad - (PI - gamma_rad) + (wrist_servo_rad - PI)
+    // wrist_servo_rad = pitch_rad - theta2_rad + PI - gamma_rad + PI
+    // Wait -> wrist_servo_rad = pitch_rad - (theta2_rad - PI + gamma_rad) + PI
+    // Let's reuse the derived formula: wrist_servo_rad = pitch_rad - elbow_global_rad + PI
+    // where elbow_global_rad = theta2_rad - (PI - gamma_rad)
+    float elbow_global_rad = theta2_rad - (PI - gamma_rad);
+    float wrist_servo_rad = pitch_rad - elbow_global_rad + PI;
+    float wrist_servo = degrees(wrist_servo_rad);
+
+    us[0] = (int)(angleToUs(0, theta1) + 0.5f);
+    us[1] = (int)(angleToUs(1, theta2) + 0.5f);
+    us[2] = (int)(angleToUs(2, gamma) + 0.5f);
+    us[3] = (int)(angleToUs(3, wrist_servo) + 0.5f);
+    return true;
+}
+
+// --- BENCHMARK ---
+// Joint poses on a coarse grid (us), IK targets are their FK so all are
+// reachable
+static void benchPose(int i, int *us)
+{
+    int pos[4] = {(i * 37) % 101, (i * 11) % 101, 20 + (i * 7) % 61, (i * 13) % 101};
+    for (int j = 0; j < 4; j++)
+        us[j] = percentToUs(j, pos[j]);
+}
+
+KinematicsBench benchKinematics(int iterations)
+{
+    KinematicsBench result = {iterations, 0, 0, 0, 0, 0, 0, 0, 0};
+    if (iterations <= 0)
+        return result;
+
+    volatile float sink = 0;
+    int us[4];
+    uint32_t start;
+
+    start = halCycles();
+    for (int i = 0; i < iterations; i++)
+    {
+        benchPose(i, us);
+        sink = sink + forwardKinematicsRef(us).x;
+    }
+    result.fkRefCycles = (halCycles() - start) / iterations;
+
+    start = halCycles();
+    for (int i = 0; i < iterations; i++)
+    {
+        benchPose(i, us);
+        sink = sink + forwardKinematics(us).x;
+    }
+    result.fkCycles = (halCycles() - start) / iterations;
+
+    // Targets computed up front so only the solve is timed
+    const int TARGETS = 64;
+    Coord targets[TARGETS];
+    for (int i = 0; i < TARGETS; i++)
+    {
+        benchPose(i, us);
+        targets[i] = forwardKinematicsRef(us);
+    }
+
+    start = halCycles();
+    for (int i = 0; i < iterations; i++)
+    {
+        const Coord &t = targets[i % TARGETS];
+        inverseKinematicsRef(t.x, t.y, t.z, t.pitch, us);
+        sink = sink + us[1];
+    }
+    result.ikRefCycles = (halCycles() - start) / iterations;
+
+    start = halCycles();
+    for (int i = 0; i < iterations; i++)
+    {
+        const Coord &t = targets[i % TARGETS];
+        inverseKinematicsElbowUp(t.x, t.y, t.z, t.pitch, us);
+        sink = sink + us[1];
+    }
+    result.ikCycles = (halCycles() - start) / iterations;
+
+    // Trig alone, libm double vs. the polynomials
+    start = halCycles();
+    for (int i = 0; i < iterations; i++)
+    {
+        float x = (i & 1023) * (1.0f / 512.0f) - 1.0f;
+        sink = sink + (float)(sin(x * 3.0) + cos(x * 3.0) + atan2(x, 0.5) + acos(x));
+    }
+    result.trigRefCycles = (halCycles() - start) / iterations;
+
+    start = halCycles();
+    for (int i = 0; i < iterations; i++)
+    {
+        float x = (i & 1023) * (1.0f / 512.0f) - 1.0f;
+        float s, c;
+        polySinCos(x * 3.0f, s, c);
+        sink = sink + s + c + polyAtan2(x, 0.5f) + polyAcos(x);
+    }
+    result.trigCycles = (halCycles() - start) / iterations;
+
+    // Accuracy: float kernels against the reference
+    for (int i = 0; i < iterations; i++)
+    {
+        benchPose(i, us);
+        Coord a = forwardKinematicsRef(us);
+        Coord b = forwardKinematics(us);
+        float err = sqrtf((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y) + (a.z - b.z) * (a.z - b.z));
+        if (err > result.fkMaxErrorCm)
+            result.fkMaxErrorCm = err;
+
+        int ref[4], fast[4];
+        if (inverseKinematicsRef(a.x, a.y, a.z, a.pitch, ref) &&
+            inverseKinematicsElbowUp(a.x, a.y, a.z, a.pitch, fast))
+        {
+            for (int j = 0; j < 4; j++)
+            {
+                int d = (int)lroundf(fabsf(usToPercent(j, ref[j]) - usToPercent(j, fast[j])));
+                if (d > result.ikMaxErrorPercent)
+                    result.ikMaxErrorPercent = d;
+            }
+        }
+    }
+    (void)sink;
+    return result;
+}
@@ -4,10 +4,15 @@
 #include <ESPmDNS.h>
 #include <WebServer.h>
 #include <ArduinoJson.h>
-#include <Wire.h>
-#include <Adafruit_PWMServoDriver.h>
-#include <math.h>
-#include <vector>
+#include "hal.h"
+#include "arm_control.h"
+#include "ik_grid.h"
+#include "ik_batch.h"
+#include "cartesian_motion.h"
+#include "joint_motion.h"
+#include "control_task.h"
+#include "recording_store.h"
+#include "keyframes.h"
 #include "web_site.h"
 #include "demos.h"
 
@@ -16,403 +21,361 @@ const char *ssid = "RobotArmMonitor";
 const char *password = "ghostarm_secret";
 const char *hostName = "ghostarm"; // URL: http://ghostarm.local
 
-// --- RECORDING DATA ---
-struct RecordedStep
-{
-    uint8_t base;
-    uint8_t shoulder;
-    uint8_t elbow;
-    uint8_t wrist;
-    uint8_t gripper;
-};
-std::vector<RecordedStep> recordingBuffer;
-bool isRecording = false;
-bool isPlaying = false;
-size_t playStep = 0;
-unsigned long lastPlayTime = 0;
-bool ikReachable = true;
 String uploadLineBuffer = "";
-
-// --- ROBOT DIMENSIONS (cm) ---
-const float L1 = 7.55;  // Base Height
-const float L2 = 9.01;  // Shoulder Length
-const float L3 = 9.005; // Elbow Length
-const float L4 = 3.25;  // Gripper Length
-
-// --- SERVO LIMITS & KINEMATICS DATA ---
-struct ServoConfig
-{
-    uint8_t pin;
-    int minUs;
-    int maxUs;
-    int startUs;
-    float angle0;   // Angle when slider is at 0%
-    float angle100; // Angle when slider is at 100%
-    String name;
-};
-
-// Index: 0=Base, 1=Shoulder, 2=Elbow, 3=Wrist, 4=Gripper
-ServoConfig servos[] = {
-    // Base: 0%=Left(85), 100%=Right(-65)
-    {11, 500, 2500, 1500, 85.0, -65.8, "Base"},
-
-    // Shoulder: SWAPPED ANGLES to fix "Wrong Way Round"
-    // If 0% on slider makes the arm go BACK/UP, then 0% = 180 degrees.
-    // If 100% on slider makes the arm go FLAT/FORWARD, then 100% = 0 degrees.
-    {12, 500, 2200, 600, 180.0, 0.0, "Shoulder"},
-
-    // Elbow: 0%=Straight(172), 100%=Bent(24)
-    {13, 500, 2500, 2400, 172.0, 24.34, "Elbow"},
-
-    // Wrist: 0%=Down(94), 100%=Up(230)
-    {14, 500, 2500, 1500, 94.5, 230.3, "Wrist"},
-
-    // Gripper
-    {15, 600, 1500, 600, 0, 0, "Gripper"}};
-
-// --- MODES ---
-enum ControlMode
-{
-    MODE_CONTROLLER = 0,
-    MODE_WEB = 1,
-    MODE_SCRIPT = 2
-};
-int currentMode = MODE_CONTROLLER;
-
-struct ScriptState
-{
-    bool active;
-    int scriptId;
-    int step;
-    unsigned long lastStepTime;
-};
-ScriptState scriptRunner = {false, 0, 0, 0};
-
-// --- DATA STRUCTURES ---
-// INCOMING ESP-NOW Message matching the Controller
-typedef struct struct_message
-{
-    uint8_t base;     // 0-100
-    uint8_t shoulder; // 0-100
-    uint8_t elbow;    // 0-100
-    uint8_t wrist;    // 0-100
-    bool grabber;     // 0 or 1
-} struct_message;
-
-struct_message incomingData;
-
-// internal state (0-100)
-// Initialize with "startUs" equivalents roughly
-int currentPos[] = {50, 0, 100, 65, 0};
-
-// Return type for Kinematics
-struct Coord
-{
-    float x;
-    float y;
-    float z;
-    float pitch;
-};
+std::vector<CartesianWaypoint> uploadPath;
 
 // --- HARDWARE OBJECTS ---
-Adafruit_PWMServoDriver pwm = Adafruit_PWMServoDriver();
 WebServer server(80);
 
-// --- HELPER FUNCTIONS ---
-
-// Converts microseconds to PWM ticks (0-4096)
-int usToTicks(int microseconds)
+// --- ESP-NOW CALLBACK ---
+// WiFi task: no lock, just stamp and queue, the control task applies it
+void OnDataRecv(const uint8_t *mac, const uint8_t *incomingDataPtr, int len)
 {
-    float pulse_length = 1000000.0 / 50.0; // 50Hz
-    return (int)(microseconds / pulse_length * 4096.0);
+    struct_message msg;
+    if (len != sizeof(msg))
+        return;
+    memcpy(&msg, incomingDataPtr, sizeof(msg));
+    queueControllerInput(msg, halMillis());
 }
 
-float mapFloat(float x, float in_min, float in_max, float out_min, float out_max)
+// --- WEB SERVER HANDLERS ---
+void handleRoot()
 {
-    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server.send(200, "text/html", "");
+    server.sendContent_P(PAGE_HTML_HEAD);
+    server.sendContent_P(PAGE_CSS);
+    server.sendContent_P(PAGE_HTML_BODY);
+    server.sendContent_P(PAGE_JS);
 }
 
-int angleToPercent(int servoIndex, float angle)
+void handleState()
 {
-    ServoConfig cfg = servos[servoIndex];
-    // Reverse logic of mapFloat: (angle - out_min) / (out_max - out_min) could work but mapFloat is generic.
-    // percent = (angle - angle0) * 100 / (angle100 - angle0)
-    // Note: angle0 corresponds to 0%, angle100 to 100%
-    float p = (angle - cfg.angle0) * 100.0 / (cfg.angle100 - cfg.angle0);
-    return (int)p;
+    String jsonString;
+    Coord pos = cachedFK(); // Seqlock, no control lock needed
+    {
+        ControlGuard guard; // For the rest: flags, counters, joints
+
+        StaticJsonDocument<640> doc;
+        doc["x"] = pos.x;
+        doc["y"] = pos.y;
+        doc["z"] = pos.z;
+        doc["p"] = pos.pitch;
+        doc["reachable"] = ikReachable;
+        doc["ikError"] = ikErrorCm;
+        doc["recording"] = isRecording;
+        doc["playing"] = isPlaying;
+        doc["moving"] = linearMove.active;
+        doc["jogging"] = jog.active;
+        doc["jointMove"] = jointMove.active;
+        doc["settled"] = servosSettled(); // Outputs caught up with the command
+        doc["busUs"] = frameStats.lastBusUs;
+        doc["i2cHz"] = halBusStatus().clockHz;
+        doc["pwmWrites"] = frameStats.writes;
+        doc["pwmSuppressed"] = frameStats.suppressed;
+        doc["pwmLost"] = frameStats.lost;
+        doc["tickJitterUs"] = controlTiming.maxJitterUs;
+        doc["tickOverruns"] = controlTiming.overruns;
+        doc["ctrlDropped"] = controllerQueueStats.dropped;
+        doc["recSize"] = recordingBuffer.size();
+        doc["wifi_connected"] = (WiFi.status() == WL_CONNECTED);
+
+        JsonArray servoArr = doc.createNestedArray("servos");
+        for (int i = 0; i < 5; i++)
+        {
+            servoArr.add(servoPercent(i));
+        }
+        JsonArray usArr = doc.createNestedArray("us");
+        for (int i = 0; i < 5; i++)
+        {
+            usArr.add(currentUs[i]);
+        }
+        serializeJson(doc, jsonString);
+    }
+    server.send(200, "application/json", jsonString);
 }
 
-// Moves a specific servo by index using percentage (0-100)
-void moveServo(int servoIndex, int percent)
+// Control task timing: jitter and run time per tick, reset=1 clears.
+// osc=<Hz> sets the measured PCA9685 oscillator (0 = datasheet value).
+void handleTiming()
 {
-    if (percent < 0)
-        percent = 0;
-    if (percent > 100)
-        percent = 100;
+    if (server.hasArg("reset"))
+        resetControlTiming();
 
-    // Save global state for kinematics
-    currentPos[servoIndex] = percent;
-
-    ServoConfig cfg = servos[servoIndex];
-
-    // Map percent to microseconds
-    // Note: Using map() for integer mapping like in Code 1
-    // Code 2 used float mapping, but for PWM output integer is fine.
-    int pulse = map(percent, 0, 100, cfg.minUs, cfg.maxUs);
-
-    // Hard-Limit Safety
-    if (pulse < cfg.minUs)
-        pulse = cfg.minUs;
-    if (pulse > cfg.maxUs)
-        pulse = cfg.maxUs;
+    bool setOsc = server.hasArg("osc");
+    uint32_t osc = setOsc ? (uint32_t)server.arg("osc").toInt() : 0;
+    HalFrameClock clock;
+    FrameLockStats lock;
+    {
+        ControlGuard guard;
+        if (setOsc)
+            halSetOscillator(osc);
+        clock = halFrameClock();
+        lock = frameLock;
+    }
+    if (setOsc)
+        halStoreOscillator(osc);
+
+    ControlTiming t = controlTiming;
+    StaticJsonDocument<384> doc;
+    doc["oscHz"] = clock.oscHz;
+    doc["frameNs"] = clock.periodNs;
+    doc["leadUs"] = FRAME_LEAD_US;
+    doc["slots"] = lock.slots;
+    doc["missed"] = lock.missed;
+    doc["resyncs"] = lock.resyncs;
+    doc["ticks"] = t.ticks;
+    doc["jitterUs"] = t.lastJitterUs;
+    doc["maxJitterUs"] = t.maxJitterUs;
+    doc["runUs"] = t.lastRunUs;
+    doc["maxRunUs"] = t.maxRunUs;
+    doc["overruns"] = t.overruns;
+    doc["busUs"] = frameStats.lastBusUs;
+    doc["maxBusUs"] = frameStats.maxBusUs;
 
-    pwm.setPWM(cfg.pin, 0, usToTicks(pulse));
+    String jsonString;
+    serializeJson(doc, jsonString);
+    server.send(200, "application/json", jsonString);
 }
 
-// --- FORWARD KINEMATICS ---
-Coord calculateFK()
-{
-    // 1. Convert Percent to Physical Angles
-    float theta1 = mapFloat(currentPos[0], 0, 100, servos[0].angle0, servos[0].angle100);
-    float theta2 = mapFloat(currentPos[1], 0, 100, servos[1].angle0, servos[1].angle100);
-    float gamma = mapFloat(currentPos[2], 0, 100, servos[2].angle0, servos[2].angle100);
-    float wristServo = mapFloat(currentPos[3], 0, 100, servos[3].angle0, servos[3].angle100);
-
-    // 2. Degrees to Radians
-    float t1_rad = radians(theta1);
-    float t2_rad = radians(theta2);
-    float gamma_rad = radians(gamma);
-
-    // 3. Global Angles
-    // Shoulder Angle: 0 = Horizontal Forward, 90 = Up.
-
-    // Elbow Global (relative to horizon)
-    float elbow_global_rad = t2_rad - (PI - gamma_rad);
-
-    // Wrist Global (Pitch)
-    float wrist_deviation_rad = radians(wristServo - 180.0);
-    float pitch_rad = elbow_global_rad + wrist_deviation_rad;
+// Float kinematics vs. the double reference, measured on the real FPU.
+// n is capped: the bench runs in the network task, which must not starve
+// the task watchdog.
+const int BENCH_KINEMATICS_MAX = 20000;
 
-    // 4. Coordinates
-    float R = L2 * cos(t2_rad) + L3 * cos(elbow_global_rad) + L4 * cos(pitch_rad);
-    float Z = L1 + L2 * sin(t2_rad) + L3 * sin(elbow_global_rad) + L4 * sin(pitch_rad);
-
-    float X = R * cos(t1_rad);
-    float Y = R * sin(t1_rad);
-
-    return {X, Y, Z, (float)degrees(pitch_rad)};
-}
-
-void calculateIK(float x, float y, float z, float pitch_deg)
+void handleBenchKinematics()
 {
-    ikReachable = true;
-
-    // 1. Base (Theta 1)
-    // atan2(y, x).
-    float theta1 = degrees(atan2(y, x));
-
-    // 2. Wrist Center
-    float R = sqrt(x * x + y * y);
-    // Singularity protection (near origin)
-    if (R < 0.1)
-        R = 0.1;
-
-    float Z_arm = z - L1; // Height relative to shoulder
-
-    // Wrist joint position
-    float pitch_rad = radians(pitch_deg);
-    float wr = R - L4 * cos(pitch_rad);
-    float wz = Z_arm - L4 * sin(pitch_rad);
-
-    // 3. Triangle L2-L3 to Reach (wr, wz)
-    float D_sq = wr * wr + wz * wz;
-    float D = sqrt(D_sq);
+    int iterations = server.hasArg("n") ? server.arg("n").toInt() : 2000;
+    iterations = iterations < 1 ? 1 : (iterations > BENCH_KINEMATICS_MAX ? BENCH_KINEMATICS_MAX : iterations);
+    KinematicsBench kb = benchKinematics(iterations);
+
+    StaticJsonDocument<256> doc;
+    doc["iterations"] = kb.iterations;
+    doc["fkRefCycles"] = kb.fkRefCycles;
+    doc["fkCycles"] = kb.fkCycles;
+    doc["ikRefCycles"] = kb.ikRefCycles;
+    doc["ikCycles"] = kb.ikCycles;
+    doc["trigRefCycles"] = kb.trigRefCycles;
+    doc["trigCycles"] = kb.trigCycles;
+    doc["fkMaxErrorCm"] = kb.fkMaxErrorCm;
+    doc["ikMaxErrorPercent"] = kb.ikMaxErrorPercent;
 
-    if (D > (L2 + L3) || D < abs(L2 - L3))
-    {
-        Serial.println("IK Target Unreachable");
-        ikReachable = false;
-        return;
-    }
-
-    // Law of Cosines for Shoulder (Alpha)
-    float c_alpha = (D_sq + L2 * L2 - L3 * L3) / (2 * D * L2);
-    // Clamp
-    if (c_alpha > 1.0)
-        c_alpha = 1.0;
-    if (c_alpha < -1.0)
-        c_alpha = -1.0;
-    float alpha_rad = acos(c_alpha);
-
-    float phi_rad = atan2(wz, wr);
-    float theta2_rad = phi_rad + alpha_rad; // Elbow UP solution
-    float theta2 = degrees(theta2_rad);
-
-    // Law of Cosines for Elbow (Gamma - included angle)
-    float c_gamma = (L2 * L2 + L3 * L3 - D_sq) / (2 * L2 * L3);
-    if (c_gamma > 1.0)
-        c_gamma = 1.0;
-    if (c_gamma < -1.0)
-        c_gamma = -1.0;
-    float gamma_rad = acos(c_gamma);
-    float gamma = degrees(gamma_rad);
-
-    // Wrist Servo
-    // FK Logic was: pitch = theta2 - (180 - gamma) + (servo - 180)
-    // pitch_rad = theta2_rad - (PI - gamma_rad) + (wrist_servo_rad - PI)
-    // wrist_servo_rad = pitch_rad - theta2_rad + PI - gamma_rad + PI
-    // Wait -> wrist_servo_rad = pitch_rad - (theta2_rad - PI + gamma_rad) + PI
-    // Let's reuse the derived formula: wrist_servo_rad = pitch_rad - elbow_global_rad + PI
-    // where elbow_global_rad = theta2_rad - (PI - gamma_rad)
-    float elbow_global_rad = theta2_rad - (PI - gamma_rad);
-    float wrist_servo_rad = pitch_rad - elbow_global_rad + PI;
-    float wrist_servo = degrees(wrist_servo_rad);
-
-    moveServo(0, angleToPercent(0, theta1));
-    moveServo(1, angleToPercent(1, theta2));
-    moveServo(2, angleToPercent(2, gamma));
-    moveServo(3, angleToPercent(3, wrist_servo));
+    String jsonString;
+    serializeJson(doc, jsonString);
+    server.send(200, "application/json", jsonString);
 }
 
-// --- ESP-NOW CALLBACK ---
-void OnDataRecv(const uint8_t *mac, const uint8_t *incomingDataPtr, int len)
+// Keyframes of recordingBuffer, worked out on a copy outside the lock.
+// Not applied if they take more bytes than the rows they replace, the
+// recording changed meanwhile or lives in a slot.
+static bool simplifyCurrentRecording(float tolerance, KeyframeUnit unit, KeyframeResult &result)
 {
-    if (len != sizeof(incomingData))
-        return;
-
-    memcpy(&incomingData, incomingDataPtr, sizeof(incomingData));
-
-    if (currentMode != MODE_CONTROLLER)
-        return;
-
-    // Ignore controller input if playing back recording
-    if (isPlaying)
-        return;
-
-    // Update logic matching Code 1
-    moveServo(0, incomingData.base);
-    moveServo(1, incomingData.shoulder);
-    moveServo(2, incomingData.elbow);
-    moveServo(3, incomingData.wrist);
-
-    // Gripper logic: bool to 0/100
-    int gripperPercent = incomingData.grabber ? 100 : 0;
-    moveServo(4, gripperPercent);
-
-    // Recording Logic
-    if (isRecording && recordingBuffer.size() < 2000)
+    Recording take;
     {
-        recordingBuffer.push_back({(uint8_t)incomingData.base,
-                                   (uint8_t)incomingData.shoulder,
-                                   (uint8_t)incomingData.elbow,
-                                   (uint8_t)incomingData.wrist,
-                                   (uint8_t)gripperPercent});
+        ControlGuard guard;
+        if (isRecording || isPlaying || recordingBuffer.spilled() || recordingBuffer.empty())
+            return false;
+        take = recordingBuffer;
     }
+    Recording keys;
+    result = simplifyRecording(take, keys, tolerance, unit);
+    if (!result.complete || !result.smaller)
+        return false;
+    ControlGuard guard;
+    if (isPlaying || !recordingBuffer.sameAs(take))
+        return false;
+    recordingBuffer = keys;
+    return true;
 }
 
-// --- WEB SERVER HANDLERS ---
-void handleRoot()
+// simplify=<tolerance> and unit=deg|percent (default percent)
+static bool simplifyArgs(float &tolerance, KeyframeUnit &unit)
 {
-    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
-    server.send(200, "text/html", "");
-    server.sendContent_P(PAGE_HTML_HEAD);
-    server.sendContent_P(PAGE_CSS);
-    server.sendContent_P(PAGE_HTML_BODY);
-    server.sendContent_P(PAGE_JS);
+    if (!server.hasArg("simplify"))
+        return false;
+    tolerance = server.arg("simplify").toFloat();
+    unit = server.arg("unit") == "deg" ? KEYFRAME_DEGREES : KEYFRAME_PERCENT;
+    return tolerance > 0;
 }
 
-void handleState()
+static void sendKeyframeResult(const KeyframeResult &result, KeyframeUnit unit, bool applied)
 {
-    // Calculate current XYZ
-    Coord pos = calculateFK();
-
-    StaticJsonDocument<512> doc;
-    doc["x"] = pos.x;
-    doc["y"] = pos.y;
-    doc["z"] = pos.z;
-    doc["p"] = pos.pitch;
-    doc["reachable"] = ikReachable;
-    doc["recording"] = isRecording;
-    doc["playing"] = isPlaying;
-    doc["recSize"] = recordingBuffer.size();
-    doc["wifi_connected"] = (WiFi.status() == WL_CONNECTED);
-
-    JsonArray servoArr = doc.createNestedArray("servos");
-    for (int i = 0; i < 5; i++)
-    {
-        servoArr.add(currentPos[i]);
-    }
+    StaticJsonDocument<256> doc;
+    doc["rows"] = result.rowsIn;
+    doc["keyframes"] = result.rowsOut;
+    doc["bytes"] = result.bytesIn;
+    doc["keyBytes"] = result.bytesOut;
+    doc["smaller"] = result.smaller;
+    doc["ratio"] = result.rowsOut ? (float)result.rowsIn / result.rowsOut : 0.0f;
+    doc["maxDeviation"] = result.maxDeviation;
+    doc["unit"] = unit == KEYFRAME_DEGREES ? "deg" : "percent";
+    doc["applied"] = applied;
 
     String jsonString;
     serializeJson(doc, jsonString);
-    server.send(200, "application/json", jsonString);
+    // Keyframes that would not save space are a result, not a conflict
+    bool larger = result.complete && !result.smaller;
+    server.send(applied || larger ? 200 : 409, "application/json", jsonString);
 }
 
+// slot=<name> records into / plays from a flash slot (see /slots). Play
+// without a slot after a slot take plays that slot.
+// simplify=<tolerance>[&unit=deg] with stop (or action=simplify) replaces
+// the recording by its keyframes when they are smaller, see keyframes.h.
+// Slot takes stay as is.
 void handleRecord()
 {
     if (server.hasArg("action"))
     {
         String action = server.arg("action");
-        if (action == "start")
+        String slot = server.hasArg("slot") ? server.arg("slot") : "";
+
+        // Slot files are opened here, outside the lock
+        if (action == "start" && slotBusy())
+        {
+            server.send(409, "text/plain", "Still saving the last take");
+            return;
+        }
+        if (action == "start" && slot.length() > 0 && !slotRecordOpen(slot.c_str()))
         {
-            isRecording = true;
-            isPlaying = false;
-            recordingBuffer.clear();
+            server.send(400, "text/plain", "Bad slot name");
+            return;
         }
-        else if (action == "stop")
+        if (action == "play")
         {
-            isRecording = false;
-            isPlaying = false;
+            {
+                ControlGuard guard;
+                if (slot.length() == 0 && recordingBuffer.spilled())
+                    slot = slotCurrent();
+                if (slot.length() > 0)
+                    isPlaying = false; // Off the read-ahead before it is refilled
+            }
+            if (slot.length() > 0 && !slotPlayOpen(slot.c_str()))
+            {
+                server.send(404, "text/plain", "No such slot");
+                return;
+            }
         }
-        else if (action == "play")
+
         {
-            if (!recordingBuffer.empty())
+            ControlGuard guard;
+            if (action == "start")
             {
-                isRecording = false;
-                isPlaying = true;
-                playStep = 0;
-                lastPlayTime = millis();
+                if (slot.length() > 0)
+                    startSlotRecording();
+                else
+                    startRecording();
             }
+            else if (action == "stop")
+                stopRecording();
+            else if (action == "play")
+            {
+                // timing=hold plays the rows as recorded, default resamples
+                if (server.hasArg("timing"))
+                    playbackMode = server.arg("timing") == "hold" ? PLAYBACK_HOLD : PLAYBACK_INTERPOLATE;
+                if (slot.length() > 0)
+                    startSlotPlayback();
+                else if (!recordingBuffer.empty())
+                    startPlayback();
+            }
+            else if (action == "clear")
+                clearRecording();
         }
-        else if (action == "clear")
+
+        float tolerance;
+        KeyframeUnit unit;
+        if ((action == "stop" || action == "simplify") && simplifyArgs(tolerance, unit))
         {
-            recordingBuffer.clear();
-            isPlaying = false;
+            KeyframeResult result = {};
+            bool applied = simplifyCurrentRecording(tolerance, unit, result);
+            sendKeyframeResult(result, unit, applied);
+            return;
         }
     }
     server.send(200, "text/plain", "OK");
 }
 
-void handleDownload()
+// Slot list as JSON, delete=<name> removes one first
+void handleSlots()
 {
-    if (recordingBuffer.empty())
+    if (server.hasArg("delete") && !slotRemove(server.arg("delete").c_str()))
     {
-        server.send(404, "text/plain", "No recording available");
+        server.send(404, "text/plain", "No such slot");
         return;
     }
-
-    String output = "Base,Shoulder,Elbow,Wrist,Gripper\n";
-    for (const auto &step : recordingBuffer)
+    StaticJsonDocument<1536> doc;
+    JsonArray arr = doc.createNestedArray("slots");
+    slotList([](const char *name, uint32_t bytes, void *ctx)
+             {
+                 JsonObject o = ((JsonArray *)ctx)->createNestedObject();
+                 o["name"] = name;
+                 o["bytes"] = bytes; },
+             &arr);
+    doc["current"] = slotCurrent();
+    doc["saving"] = slotBusy();
     {
-        output += String(step.base) + "," + String(step.shoulder) + "," +
-                  String(step.elbow) + "," + String(step.wrist) + "," +
-                  String(step.gripper) + "\n";
+        ControlGuard guard;
+        doc["starved"] = slotReader.starved;
     }
+    String jsonString;
+    serializeJson(doc, jsonString);
+    server.send(200, "application/json", jsonString);
+}
 
-    server.sendHeader("Content-Disposition", "attachment; filename=recording.csv");
-    server.send(200, "text/csv", output);
+static void csvRow(String &output, const RecordedStep &step, uint32_t timeMs)
+{
+    output += String(step.base) + "," + String(step.shoulder) + "," + String(step.elbow) + "," +
+              String(step.wrist) + "," + String(step.gripper) + "," + String(timeMs) + "\n";
+    if (output.length() >= 1024)
+    {
+        server.sendContent(output);
+        output = "";
+    }
 }
 
-void processLine(String line)
+// slot=<name> downloads a flash slot, read straight from the file
+void handleDownload()
 {
-    if (line.startsWith("Base"))
-        return; // Header
+    // Copy the encoded bytes under the lock, decode and format without it
+    Recording steps;
+    String slot = server.hasArg("slot") ? server.arg("slot") : "";
+    {
+        ControlGuard guard;
+        if (slot.length() == 0 && recordingBuffer.spilled())
+            slot = slotCurrent();
+        if (slot.length() == 0)
+            steps = recordingBuffer;
+    }
+    // Opened before the 200 goes out: a missing slot is a 404, not an empty CSV
+    int file = slot.length() > 0 ? slotOpenRead(slot.c_str()) : -1;
+    if (slot.length() > 0 ? file < 0 : steps.empty())
+    {
+        server.send(404, "text/plain", "No recording available");
+        return;
+    }
+
+    // Chunked: the CSV of a full recording is far bigger than the heap
+    server.sendHeader("Content-Disposition", "attachment; filename=recording.csv");
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server.send(200, "text/csv", "Base_us,Shoulder_us,Elbow_us,Wrist_us,Gripper_us,Time_ms\n");
 
-    int b, s, e, w, g;
-    if (sscanf(line.c_str(), "%d,%d,%d,%d,%d", &b, &s, &e, &w, &g) == 5)
+    String output;
+    output.reserve(1100);
+    if (slot.length() > 0)
     {
-        recordingBuffer.push_back({(uint8_t)b, (uint8_t)s, (uint8_t)e, (uint8_t)w, (uint8_t)g});
+        slotDecodeFile(file, [](const RecordedStep &step, uint32_t timeMs, void *ctx)
+                       { csvRow(*(String *)ctx, step, timeMs); },
+                       &output);
     }
+    else
+    {
+        Recording::Cursor cursor = steps.cursor();
+        RecordedStep step;
+        while (cursor.next(step))
+            csvRow(output, step, cursor.timeMs());
+    }
+    if (output.length() > 0)
+        server.sendContent(output);
 }
 
 void handleLoadDemo()
@@ -438,50 +401,26 @@ void handleLoadDemo()
         return;
     }
 
-    recordingBuffer.clear();
-
-    // Read from PROGMEM
-    String lineBuffer = "";
-    int i = 0;
-    while (true)
+    size_t steps;
     {
-        char c = pgm_read_byte(demoPtr + i);
-        if (c == 0)
-            break; // End of string
+        ControlGuard guard;
+        loadRecordingCsv(demoPtr);
 
-        if (c == '\n' || c == '\r')
-        {
-            if (lineBuffer.length() > 0)
-            {
-                processLine(lineBuffer);
-                lineBuffer = "";
-            }
-        }
-        else
-        {
-            lineBuffer += c;
-        }
-        i++;
+        // Start playing
+        startPlayback();
+        steps = recordingBuffer.size();
     }
-    // Process last line
-    if (lineBuffer.length() > 0)
-        processLine(lineBuffer);
 
-    // Start playing
-    isRecording = false;
-    isPlaying = true;
-    playStep = 0;
-    lastPlayTime = millis();
-
-    server.send(200, "application/json", "{\"status\":\"ok\", \"steps\":" + String(recordingBuffer.size()) + "}");
+    server.send(200, "application/json", "{\"status\":\"ok\", \"steps\":" + String(steps) + "}");
 }
 
 void onScriptUpload()
 {
     HTTPUpload &upload = server.upload();
+    ControlGuard guard; // One chunk at a time, parsing is short
     if (upload.status == UPLOAD_FILE_START)
     {
-        recordingBuffer.clear();
+        clearRecording();
         uploadLineBuffer = "";
         Serial.printf("Upload Start: %s\n", upload.filename.c_str());
     }
@@ -494,7 +433,7 @@ void onScriptUpload()
             {
                 if (uploadLineBuffer.length() > 0)
                 {
-                    processLine(uploadLineBuffer);
+                    processLine(uploadLineBuffer.c_str());
                     uploadLineBuffer = "";
                 }
             }
@@ -508,30 +447,107 @@ void onScriptUpload()
     {
         // Process last line if any
         if (uploadLineBuffer.length() > 0)
-            processLine(uploadLineBuffer);
+            processLine(uploadLineBuffer.c_str());
 
         Serial.printf("Upload End. Steps: %u\n", recordingBuffer.size());
-        isRecording = false;
-        isPlaying = true;
-        playStep = 0;
-        lastPlayTime = millis();
+        if (!server.hasArg("simplify"))
+            startPlayback(); // Else after the keyframes, in handleScriptUploaded()
     }
 }
 
-void handleSetMode()
+void handleScriptUploaded()
 {
-    if (server.hasArg("mode"))
+    float tolerance;
+    KeyframeUnit unit;
+    if (!simplifyArgs(tolerance, unit))
+    {
+        server.send(200, "text/plain", "");
+        return;
+    }
+    KeyframeResult result = {};
+    bool applied = simplifyCurrentRecording(tolerance, unit, result);
     {
-        currentMode = server.arg("mode").toInt();
-        if (currentMode != MODE_SCRIPT)
-            scriptRunner.active = false;
+        ControlGuard guard;
+        if (!recordingBuffer.empty())
+            startPlayback();
+    }
+    sendKeyframeResult(result, unit, applied);
+}
 
-        // Stop recording if leaving controller mode
-        if (currentMode != MODE_CONTROLLER)
+// Cartesian path upload: "x,y,z,pitch[,gripper]" rows, solved in one pass
+void onPathUpload()
+{
+    HTTPUpload &upload = server.upload();
+    if (upload.status == UPLOAD_FILE_START)
+    {
+        uploadPath.clear();
+        uploadLineBuffer = "";
+    }
+    else if (upload.status == UPLOAD_FILE_WRITE)
+    {
+        for (size_t i = 0; i < upload.currentSize; i++)
         {
-            isRecording = false;
+            char c = (char)upload.buf[i];
+            if (c == '\n' || c == '\r')
+            {
+                CartesianWaypoint wp;
+                if (uploadLineBuffer.length() > 0 && parseWaypointLine(uploadLineBuffer.c_str(), wp))
+                    uploadPath.push_back(wp);
+                uploadLineBuffer = "";
+            }
+            else
+            {
+                uploadLineBuffer += c;
+            }
         }
+    }
+    else if (upload.status == UPLOAD_FILE_END)
+    {
+        CartesianWaypoint wp;
+        if (uploadLineBuffer.length() > 0 && parseWaypointLine(uploadLineBuffer.c_str(), wp))
+            uploadPath.push_back(wp);
+        uploadLineBuffer = "";
+    }
+}
 
+void handlePathUploaded()
+{
+    // Solved without the lock, the lock only swaps the recording in
+    int from[4];
+    {
+        ControlGuard guard;
+        for (int i = 0; i < 4; i++)
+            from[i] = currentUs[i];
+    }
+    Recording path;
+    IkBatchResult result = solvePathRecording(uploadPath.data(), uploadPath.size(), from, path);
+    bool playable = result.firstUnreachable < 0 && !result.tooLong;
+    if (playable)
+    {
+        ControlGuard guard;
+        playSolvedPath(path);
+    }
+
+    StaticJsonDocument<192> doc;
+    doc["status"] = playable ? "ok" : (result.tooLong ? "too long" : "unreachable");
+    doc["points"] = uploadPath.size();
+    doc["steps"] = result.solved; // Too long: the steps that fit
+    doc["firstUnreachable"] = result.firstUnreachable;
+
+    uploadPath.clear();
+    uploadPath.shrink_to_fit();
+
+    String jsonString;
+    serializeJson(doc, jsonString);
+    server.send(playable ? 200 : (result.tooLong ? 413 : 422), "application/json", jsonString);
+}
+
+void handleSetMode()
+{
+    if (server.hasArg("mode"))
+    {
+        ControlGuard guard;
+        setControlMode(server.arg("mode").toInt());
         server.send(200, "text/plain", "Mode Set");
     }
     else
@@ -545,12 +561,18 @@ void handleSetServo()
     // Mode check removed to allow voice control override
     // if (currentMode != MODE_WEB) ...
 
-    if (server.hasArg("index") && server.hasArg("value"))
+    // value = percent (sliders), us = pulse width
+    if (server.hasArg("index") && (server.hasArg("value") || server.hasArg("us")))
     {
         int idx = server.arg("index").toInt();
-        int val = server.arg("value").toInt();
         if (idx >= 0 && idx < 5)
-            moveServo(idx, val);
+        {
+            ControlGuard guard;
+            if (server.hasArg("us"))
+                moveServoUs(idx, server.arg("us").toInt());
+            else
+                moveServo(idx, server.arg("value").toInt());
+        }
         server.send(200, "text/plain", "OK");
     }
     else
@@ -572,8 +594,165 @@ void handleSetXYZ()
         float y = server.arg("y").toFloat();
         float z = server.arg("z").toFloat();
         float p = server.arg("p").toFloat();
-        calculateIK(x, y, z, p);
-        server.send(200, "text/plain", "Moved");
+        bool relax = server.hasArg("relax") && server.arg("relax").toInt() != 0;
+        bool linear = !(server.hasArg("linear") && server.arg("linear").toInt() == 0);
+
+        // Default: straight line at linearSpeedCmS, planned without the lock
+        // from where the arm holds (see planLinearMove()). linear=0 is a
+        // synchronized joint move. Out of reach targets go to the nearest
+        // reachable pose.
+        IkProjection proj;
+        const char *status = "moving";
+        if (linear)
+        {
+            int from[4];
+            float speed;
+            {
+                ControlGuard guard;
+                if (server.hasArg("speed"))
+                    linearSpeedCmS = server.arg("speed").toFloat();
+                speed = linearSpeedCmS;
+                // The running move ends here, the new line starts where it stops
+                stopCartesianMotion();
+                stopJointMove();
+                settleServos(CARTESIAN_JOINTS);
+                for (int i = 0; i < 4; i++)
+                    from[i] = currentUs[i];
+            }
+            LinePlan plan;
+            planLinearMove(from, x, y, z, p, relax, speed, plan);
+            bool started;
+            {
+                ControlGuard guard;
+                started = startPlannedLinearMove(plan);
+            }
+            proj = plan.proj;
+            status = started ? "moving" : (plan.blocked ? "blocked" : "busy");
+        }
+        else
+        {
+            ControlGuard guard;
+            if (server.hasArg("speed"))
+                linearSpeedCmS = server.arg("speed").toFloat();
+            proj = startJointMoveToXYZ(x, y, z, p, relax);
+        }
+
+        StaticJsonDocument<256> doc;
+        doc["status"] = status;
+        doc["reachable"] = !proj.projected && !proj.pitchRelaxed;
+        doc["pitchRelaxed"] = proj.pitchRelaxed;
+        doc["error"] = proj.errorCm;
+        doc["x"] = proj.reached.x;
+        doc["y"] = proj.reached.y;
+        doc["z"] = proj.reached.z;
+        doc["p"] = proj.reached.pitch;
+
+        String jsonString;
+        serializeJson(doc, jsonString);
+        server.send(200, "application/json", jsonString);
+    }
+    else
+    {
+        server.send(400, "text/plain", "Missing args");
+    }
+}
+
+// Velocity jog: vx, vy, vz (cm/s), vp (deg/s), optional ms. One request
+// keeps the arm moving until ms runs out, stop=1 or the next jog request.
+void handleJog()
+{
+    if (currentMode != MODE_WEB)
+    {
+        server.send(403, "text/plain", "Not in Web Mode");
+        return;
+    }
+    if (server.hasArg("stop"))
+    {
+        {
+            ControlGuard guard;
+            stopCartesianMotion();
+        }
+        server.send(200, "text/plain", "Stopped");
+        return;
+    }
+    float vx = server.hasArg("vx") ? server.arg("vx").toFloat() : 0.0f;
+    float vy = server.hasArg("vy") ? server.arg("vy").toFloat() : 0.0f;
+    float vz = server.hasArg("vz") ? server.arg("vz").toFloat() : 0.0f;
+    float vp = server.hasArg("vp") ? server.arg("vp").toFloat() : 0.0f;
+    unsigned long ms = server.hasArg("ms") ? server.arg("ms").toInt() : 0;
+    float manipulability;
+    {
+        ControlGuard guard;
+        startJog(vx, vy, vz, vp, ms);
+        manipulability = jog.manipulability;
+    }
+
+    StaticJsonDocument<128> doc;
+    doc["status"] = "jogging";
+    doc["manipulability"] = manipulability;
+    String jsonString;
+    serializeJson(doc, jsonString);
+    server.send(200, "application/json", jsonString);
+}
+
+// Synchronized joint move: us = five pulse widths (-1 keeps a joint),
+// optional speed in percent of the joint limits
+void handleMoveJoints()
+{
+    if (currentMode != MODE_WEB)
+    {
+        server.send(403, "text/plain", "Not in Web Mode");
+        return;
+    }
+    int us[NUM_SERVOS];
+    if (!server.hasArg("us") || sscanf(server.arg("us").c_str(), "%d,%d,%d,%d,%d", &us[0], &us[1], &us[2],
+                                       &us[3], &us[4]) != NUM_SERVOS)
+    {
+        server.send(400, "text/plain", "Missing args");
+        return;
+    }
+    uint8_t mask = 0;
+    for (int i = 0; i < NUM_SERVOS; i++)
+        if (us[i] >= 0)
+            mask |= 1 << i;
+    float speed = server.hasArg("speed") ? server.arg("speed").toFloat() / 100.0f : 1.0f;
+
+    float ms;
+    {
+        ControlGuard guard;
+        ms = startJointMove(us, mask, speed);
+    }
+
+    StaticJsonDocument<96> doc;
+    doc["status"] = "moving";
+    doc["durationMs"] = ms;
+    String jsonString;
+    serializeJson(doc, jsonString);
+    server.send(200, "application/json", jsonString);
+}
+
+// Reachability from the IK grid (exact IK where it says no), no motion.
+// Cheap enough for UI validation. seed is in us.
+void handleCheckXYZ()
+{
+    if (server.hasArg("x") && server.hasArg("y") && server.hasArg("z") && server.hasArg("p"))
+    {
+        float seed[4];
+        bool reachable = ikGridReachableExact(server.arg("x").toFloat(), server.arg("y").toFloat(),
+                                              server.arg("z").toFloat(), server.arg("p").toFloat(), seed);
+
+        StaticJsonDocument<192> doc;
+        doc["reachable"] = reachable;
+        if (reachable)
+        {
+            JsonArray seedArr = doc.createNestedArray("seed");
+            for (int i = 0; i < 4; i++)
+                seedArr.add(seed[i]);
+        }
+
+        String jsonString;
+        serializeJson(doc, jsonString);
+        server.send(200, "application/json", jsonString);
     }
     else
     {
@@ -627,11 +806,10 @@ void handleRunScript()
 {
     if (server.hasArg("id"))
     {
-        currentMode = MODE_SCRIPT;
-        scriptRunner.active = true;
-        scriptRunner.scriptId = server.arg("id").toInt();
-        scriptRunner.step = 0;
-        scriptRunner.lastStepTime = 0;
+        {
+            ControlGuard guard;
+            startScript(server.arg("id").toInt());
+        }
         server.send(200, "text/plain", "Script Started");
     }
     else
@@ -640,19 +818,32 @@ void handleRunScript()
     }
 }
 
+// --- NETWORK TASK ---
+// HTTP on core 0 next to the WiFi stack, core 1 belongs to the control task
+void networkTask(void *)
+{
+    for (;;)
+    {
+        server.handleClient();
+        recordingStoreService(); // Slot file I/O
+
+        // Allow a tiny delay for network stability
+        vTaskDelay(pdMS_TO_TICKS(2));
+    }
+}
+
 void setup()
 {
     Serial.begin(115200);
-    Wire.begin(21, 22);
 
     // 1. PWM Init
-    pwm.begin();
-    pwm.setPWMFreq(50);
-
-    for (int i = 0; i < 5; i++)
-    {
-        pwm.setPWM(servos[i].pin, 0, usToTicks(servos[i].startUs));
-    }
+    halBegin();
+    if (!recordingStoreBegin())
+        Serial.println("Flash filesystem failed, no recording slots");
+    homeServos(); // First full frame, timed
+    Serial.printf("Servo frame: %lu us at %lu Hz\n", (unsigned long)frameStats.lastBusUs,
+                  (unsigned long)halBusStatus().clockHz);
+    startControlTask(); // Servo output, playback and scripts on core 1 from here on
 
     // 2. WiFi Setup (Combine AP and Station)
     WiFi.mode(WIFI_AP_STA);
@@ -688,14 +879,21 @@ void setup()
     server.on("/set_mode", handleSetMode);
     server.on("/set_servo", handleSetServo);
     server.on("/set_xyz", handleSetXYZ);
+    server.on("/check_xyz", handleCheckXYZ);
+    server.on("/jog", handleJog);
+    server.on("/move_joints", handleMoveJoints);
     server.on("/run_script", handleRunScript);
     server.on("/record", handleRecord);
     server.on("/connect_wifi", handleConnectWifi); // Added
     server.on("/download", handleDownload);
-    server.on("/upload_script", HTTP_POST, []()
-              { server.send(200, "text/plain", ""); }, onScriptUpload);
+    server.on("/slots", handleSlots);
+    server.on("/upload_script", HTTP_POST, handleScriptUploaded, onScriptUpload);
+    server.on("/upload_path", HTTP_POST, handlePathUploaded, onPathUpload);
     server.on("/load_demo", handleLoadDemo);
+    server.on("/bench_kinematics", handleBenchKinematics);
+    server.on("/timing", handleTiming);
     server.begin();
+    xTaskCreatePinnedToCore(networkTask, "network", 8192, nullptr, 1, nullptr, 0);
 
     Serial.println("Server & Robot Ready");
     Serial.print("MAC Address: ");
@@ -704,102 +902,6 @@ void setup()
 
 void loop()
 {
-    server.handleClient();
-
-    // Playback Logic
-    if (isPlaying && !recordingBuffer.empty())
-    {
-        unsigned long now = millis();
-        if (now - lastPlayTime > 20)
-        { // ~50Hz Playback
-            if (playStep < recordingBuffer.size())
-            {
-                const auto &step = recordingBuffer[playStep];
-                moveServo(0, step.base);
-                moveServo(1, step.shoulder);
-                moveServo(2, step.elbow);
-                moveServo(3, step.wrist);
-                moveServo(4, step.gripper);
-                playStep++;
-                lastPlayTime = now;
-            }
-            else
-            {
-                isPlaying = false; // Done
-            }
-        }
-    }
-
-    if (currentMode == MODE_SCRIPT && scriptRunner.active)
-    {
-        unsigned long now = millis();
-        // Script 1: Wave
-        if (scriptRunner.scriptId == 1)
-        {
-            if (scriptRunner.step == 0 && (now - scriptRunner.lastStepTime > 100))
-            {
-                moveServo(2, 50); // Elbow Up
-                moveServo(3, 50); // Wrist mid
-                scriptRunner.step++;
-                scriptRunner.lastStepTime = now;
-            }
-            else if (scriptRunner.step == 1 && (now - scriptRunner.lastStepTime > 1000))
-            {
-                moveServo(3, 80); // Wrist Up
-                scriptRunner.step++;
-                scriptRunner.lastStepTime = now;
-            }
-            else if (scriptRunner.step == 2 && (now - scriptRunner.lastStepTime > 500))
-            {
-                moveServo(3, 20); // Wrist Down
-                scriptRunner.step++;
-                scriptRunner.lastStepTime = now;
-            }
-            else if (scriptRunner.step == 3 && (now - scriptRunner.lastStepTime > 500))
-            {
-                moveServo(3, 80); // Wrist Up
-                scriptRunner.step++;
-                scriptRunner.lastStepTime = now;
-            }
-            else if (scriptRunner.step == 4 && (now - scriptRunner.lastStepTime > 500))
-            {
-                moveServo(3, 50);            // Center
-                scriptRunner.active = false; // Done
-            }
-        }
-        // Script 2: Pick Place Demo
-        else if (scriptRunner.scriptId == 2)
-        {
-            if (scriptRunner.step == 0)
-            {
-                moveServo(4, 0);          // Open
-                calculateIK(15, 0, 5, 0); // Go down
-                scriptRunner.step++;
-                scriptRunner.lastStepTime = now;
-            }
-            else if (scriptRunner.step == 1 && (now - scriptRunner.lastStepTime > 2000))
-            {
-                moveServo(4, 100); // Close
-                scriptRunner.step++;
-                scriptRunner.lastStepTime = now;
-            }
-            else if (scriptRunner.step == 2 && (now - scriptRunner.lastStepTime > 1000))
-            {
-                calculateIK(15, 0, 15, 0); // Up
-                scriptRunner.step++;
-                scriptRunner.lastStepTime = now;
-            }
-            else if (scriptRunner.step == 3 && (now - scriptRunner.lastStepTime > 2000))
-            {
-                scriptRunner.active = false;
-            }
-        }
-        else if (scriptRunner.scriptId == 3)
-        {
-            scriptRunner.active = false;
-        }
-    }
-
-    // Allow a tiny delay for network stability
-    delay(5);
+    // Everything runs in networkTask and the control task
+    delay(1000);
 }
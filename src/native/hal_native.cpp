@@ -0,0 +1,334 @@
+#include <chrono>
+#include <dirent.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <sys/stat.h>
+#include "hal.h"
+#include "sim_hal.h"
+
+SimPCA9685 simPwm;
+
+static uint32_t simMicros = 0;
+static uint32_t simMicrosPerRead = 0;
+static bool simQuiet = false;
+static HalBusStatus simBus = {100000, 0, 0}; // Wire default
+static int simClockStep = HAL_I2C_CLOCK_COUNT - 1;
+static uint32_t simI2cMaxHz = 1000000;
+static uint32_t simI2cFailures = 0;
+static uint32_t simStoredOscHz = HAL_PCA9685_OSC_HZ; // "Flash", survives halBegin()
+static HalFrameClock simFrameClock = {0, 20000000, HAL_PCA9685_OSC_HZ};
+
+// --- SIMULATED PCA9685 ---
+void SimPCA9685::setPWM(uint8_t channel, uint16_t on, uint16_t off)
+{
+    if (channel >= 16)
+        return;
+    offTicks[channel] = off;
+    if (logging)
+        writeLog.push_back({simMicros, channel, on, off, nextFrameUs(simMicros)});
+}
+
+void SimPCA9685::startFrames(uint8_t prescaler, uint32_t us)
+{
+    prescale = prescaler;
+    originUs = us;
+    stopped = false;
+}
+
+void SimPCA9685::stopFrame(uint32_t us)
+{
+    stopped = true;
+    stopUs = us;
+}
+
+void SimPCA9685::restartFrame(uint32_t us)
+{
+    if (stopped && (int32_t)(us - nextFrameUs(stopUs)) >= 0)
+        cutCount++;
+    stopped = false;
+    originUs = us;
+}
+
+uint32_t SimPCA9685::nextFrameUs(uint32_t us) const
+{
+    double period = framePeriodUs();
+    double n = ceil((uint32_t)(us - originUs) / period);
+    return originUs + (uint32_t)llround(n * period);
+}
+
+void SimPCA9685::reset()
+{
+    for (int i = 0; i < 16; i++)
+        offTicks[i] = 0;
+    clearLog();
+}
+
+void SimPCA9685::clearLog()
+{
+    writeLog.clear();
+    burstCount = 0;
+    cutCount = 0;
+}
+
+uint32_t simI2cMicros(uint32_t bytes)
+{
+    return (bytes * 9 * 1000000UL + simBus.clockHz - 1) / simBus.clockHz;
+}
+
+// --- SIMULATED I2C BUS ---
+void simSetI2cMaxClock(uint32_t hz)
+{
+    simI2cMaxHz = hz;
+}
+
+void simFailI2c(uint32_t transactions)
+{
+    simI2cFailures = transactions;
+}
+
+static void setBusClock(int step)
+{
+    simClockStep = step;
+    simBus.clockHz = HAL_I2C_CLOCKS[step];
+}
+
+// One transaction on the simulated bus, fails above the max clock or when
+// a failure was injected
+static bool simTransaction()
+{
+    if (simI2cFailures)
+    {
+        simI2cFailures--;
+        return false;
+    }
+    return simBus.clockHz <= simI2cMaxHz;
+}
+
+// --- SIMULATED CLOCK ---
+void simSetMicros(uint32_t us)
+{
+    simMicros = us;
+}
+
+void simAdvanceMicros(uint32_t us)
+{
+    simMicros += us;
+}
+
+void simSetMicrosPerRead(uint32_t perRead)
+{
+    simMicrosPerRead = perRead;
+}
+
+void simSetQuiet(bool quiet)
+{
+    simQuiet = quiet;
+}
+
+// --- FRAME CLOCK ---
+// Prescaler from the oscillator the HAL believes in, like setPWMFreq(50)
+static void startPwm(uint32_t oscHz)
+{
+    float prescale = oscHz / (50.0f * 4096.0f) + 0.5f - 1.0f;
+    prescale = prescale < 3 ? 3 : (prescale > 255 ? 255 : prescale);
+    simFrameClock.oscHz = oscHz;
+    simFrameClock.periodNs = (uint32_t)(((uint8_t)prescale + 1) * 4096ULL * 1000000000ULL / oscHz);
+    simFrameClock.originUs = simMicros;
+    simPwm.startFrames((uint8_t)prescale, simMicros);
+}
+
+HalFrameClock halFrameClock()
+{
+    return simFrameClock;
+}
+
+void halSetOscillator(uint32_t oscHz)
+{
+    startPwm(oscHz ? oscHz : HAL_PCA9685_OSC_HZ);
+}
+
+void halStoreOscillator(uint32_t oscHz)
+{
+    simStoredOscHz = oscHz ? oscHz : HAL_PCA9685_OSC_HZ;
+}
+
+// The MODE1 read stands in for the whole sleep/wake sequence on the bus
+bool halStopFrame()
+{
+    if (!simTransaction())
+    {
+        simBus.errors++;
+        return false;
+    }
+    simPwm.stopFrame(simMicros);
+    return true;
+}
+
+void halRestartFrame()
+{
+    simFrameClock.originUs = simMicros;
+    simPwm.restartFrame(simMicros);
+}
+
+// MODE1 read and three writes, 13 bytes
+uint32_t halFrameRestartUs()
+{
+    return HAL_PCA9685_STARTUP_US + simI2cMicros(13);
+}
+
+// --- HAL ---
+void halBegin()
+{
+    simPwm.reset();
+    startPwm(simStoredOscHz);
+    simBus = {100000, 0, 0};
+    for (int step = 0; step < HAL_I2C_CLOCK_COUNT; step++)
+    {
+        setBusClock(step);
+        if (simTransaction())
+            break;
+        simBus.errors++;
+        if (step + 1 < HAL_I2C_CLOCK_COUNT)
+            simBus.fallbacks++;
+    }
+}
+
+HalBusStatus halBusStatus()
+{
+    return simBus;
+}
+
+uint32_t halMillis()
+{
+    return simMicros / 1000;
+}
+
+uint32_t halMicros()
+{
+    uint32_t now = simMicros;
+    simMicros += simMicrosPerRead;
+    return now;
+}
+
+// Host cycle counter: TSC on x86, nanoseconds elsewhere
+uint32_t halCycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return (uint32_t)__builtin_ia32_rdtsc();
+#else
+    return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#endif
+}
+
+void halSetPWM(uint8_t channel, uint16_t on, uint16_t off)
+{
+    simPwm.setPWM(channel, on, off);
+}
+
+bool halWriteBurst(uint8_t firstChannel, const uint16_t *offTicks, uint8_t count, uint32_t &busUs)
+{
+    // Address + register + 4 bytes per channel, 9 clocks per byte
+    busUs = simI2cMicros(2 + 4 * count);
+    while (!simTransaction())
+    {
+        simBus.errors++;
+        if (simClockStep + 1 >= HAL_I2C_CLOCK_COUNT)
+            return false; // Burst lost
+        setBusClock(simClockStep + 1);
+        simBus.fallbacks++;
+        busUs += simI2cMicros(2 + 4 * count);
+    }
+    for (uint8_t i = 0; i < count; i++)
+        simPwm.setPWM(firstChannel + i, 0, offTicks[i]);
+    simPwm.countBurst();
+    return true;
+}
+
+// --- FILES ---
+// A fresh directory per run, kept afterwards for a look at the files
+static std::string simFsRoot;
+static FILE *simFiles[HAL_FILE_MAX];
+
+bool halFileBegin()
+{
+    if (!simFsRoot.empty())
+        return true;
+    char dir[] = "/tmp/arm_fs_XXXXXX";
+    if (!mkdtemp(dir))
+        return false;
+    simFsRoot = dir;
+    return true;
+}
+
+int halFileOpen(const char *path, const char *mode)
+{
+    if (!halFileBegin())
+        return -1;
+    std::string full = simFsRoot + path;
+    if (mode[0] == 'w')
+    {
+        for (size_t i = simFsRoot.size() + 1; (i = full.find('/', i)) != std::string::npos; i++)
+            mkdir(full.substr(0, i).c_str(), 0755);
+    }
+    for (int i = 0; i < HAL_FILE_MAX; i++)
+    {
+        if (simFiles[i])
+            continue;
+        simFiles[i] = fopen(full.c_str(), mode[0] == 'w' ? "wb" : "rb");
+        return simFiles[i] ? i : -1;
+    }
+    return -1;
+}
+
+int halFileRead(int file, uint8_t *buf, int len)
+{
+    return (int)fread(buf, 1, len, simFiles[file]);
+}
+
+int halFileWrite(int file, const uint8_t *buf, int len)
+{
+    return (int)fwrite(buf, 1, len, simFiles[file]);
+}
+
+void halFileSync(int file)
+{
+    fflush(simFiles[file]);
+}
+
+void halFileClose(int file)
+{
+    fclose(simFiles[file]);
+    simFiles[file] = nullptr;
+}
+
+bool halFileRemove(const char *path)
+{
+    return halFileBegin() && remove((simFsRoot + path).c_str()) == 0;
+}
+
+void halFileList(const char *dir, void (*onFile)(const char *name, uint32_t size, void *ctx), void *ctx)
+{
+    if (!halFileBegin())
+        return;
+    std::string full = simFsRoot + dir;
+    DIR *d = opendir(full.c_str());
+    if (!d)
+        return;
+    while (struct dirent *e = readdir(d))
+    {
+        struct stat st;
+        if (stat((full + "/" + e->d_name).c_str(), &st) == 0 && S_ISREG(st.st_mode))
+            onFile(e->d_name, (uint32_t)st.st_size, ctx);
+    }
+    closedir(d);
+}
+
+void halLog(const char *msg)
+{
+    if (!simQuiet)
+        printf("[hal] %s\n", msg);
+}
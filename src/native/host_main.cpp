@@ -0,0 +1,1321 @@
+// Host entry point for the native environment: benchmarks and stress runs of
+// the control core against the simulated PCA9685.
+//
+//   pio run -e native && .pio/build/native/program [bench|stress|trace <demo>]
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hal.h"
+#include "arm_control.h"
+#include "ik_grid.h"
+#include "ik_batch.h"
+#include "cartesian_motion.h"
+#include "joint_motion.h"
+#include "keyframes.h"
+#include "recording_store.h"
+#include <math.h>
+#include "demos.h"
+#include "sim_hal.h"
+
+static volatile float benchSink = 0;
+
+template <typename F>
+static void bench(const char *name, long iterations, F body)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < iterations; i++)
+        body(i);
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    printf("%-28s %10ld iter %10.1f ns/op\n", name, iterations, ns / iterations);
+}
+
+static const char *demoByName(const char *name)
+{
+    if (strcmp(name, "hello") == 0)
+        return demo_hello;
+    if (strcmp(name, "picknplace") == 0)
+        return demo_picknplace;
+    if (strcmp(name, "dancing") == 0)
+        return demo_dancing;
+    return nullptr;
+}
+
+// Runs the loaded recording to completion, 1ms of simulated time per tick.
+// Frame restarts are finished on time, like the control task does.
+static long runPlayback()
+{
+    long ticks = 0;
+    startPlayback();
+    while (isPlaying)
+    {
+        simAdvanceMicros(1000);
+        controlTick();
+        uint32_t restartUs;
+        if (frameRestartPending(restartUs))
+        {
+            int32_t wait = (int32_t)(restartUs - halMicros());
+            simAdvanceMicros(wait > 0 ? wait : 0);
+            finishFrameRestart();
+        }
+        ticks++;
+    }
+    return ticks;
+}
+
+// --- BENCH ---
+static int runBench()
+{
+    simSetQuiet(true);
+    simPwm.setLogging(false);
+
+    bench("calculateFK (moving)", 1000000, [](long i)
+          {
+              moveServo(0, i % 101);
+              moveServo(3, (i / 101) % 101);
+              benchSink += calculateFK().x; });
+
+    bench("calculateFK (idle)", 1000000, [](long)
+          { benchSink += calculateFK().x; });
+
+    bench("calculateIK (reachable)", 1000000, [](long i)
+          { calculateIK(12.0f + (i % 64) * 0.05f, (i % 32) * 0.1f, 12.0f, 0.0f); });
+
+    bench("calculateIK (unreachable)", 1000000, [](long i)
+          { calculateIK(40.0f + (i % 64) * 0.1f, 0.0f, 5.0f, 0.0f); });
+
+    bench("ikGridLookup", 1000000, [](long i)
+          {
+              float seed[4];
+              benchSink += ikGridLookup(10.0f + (i % 64) * 0.1f, (i % 32) * 0.1f, 5.0f, 0.0f, seed) ? seed[1] : 0; });
+
+    std::vector<CartesianWaypoint> circle(1000);
+    for (size_t i = 0; i < circle.size(); i++)
+    {
+        float a = i * 6.2831853f / circle.size();
+        circle[i] = {14.0f + 3.0f * cosf(a), 3.0f * sinf(a), 12.0f, 0.0f, 0};
+    }
+    std::vector<RecordedStep> trajectory;
+    bench("solveIKBatch (1000 pts)", 1000, [&](long)
+          { solveIKBatch(circle.data(), circle.size(), trajectory); });
+
+    bench("processLine", 1000000, [](long i)
+          {
+              if ((i & 1023) == 0)
+                  recordingBuffer.clear();
+              processLine("52,0,100,53,0"); });
+
+    bench("loadRecordingCsv (dancing)", 1000, [](long)
+          { loadRecordingCsv(demo_dancing); });
+
+    Recording::Cursor cursor = recordingBuffer.cursor();
+    bench("recording cursor (row)", 1000000, [&cursor](long)
+          {
+              RecordedStep step = {};
+              if (!cursor.next(step))
+                  cursor = recordingBuffer.cursor();
+              benchSink += step.base; });
+
+    KinematicsBench kb = benchKinematics(200000);
+    printf("\nkinematics, cycles/call   double ref  kernel   speedup\n");
+    printf("  FK                      %10u %7u %8.1fx\n", kb.fkRefCycles, kb.fkCycles,
+           (float)kb.fkRefCycles / (kb.fkCycles ? kb.fkCycles : 1));
+    printf("  IK                      %10u %7u %8.1fx\n", kb.ikRefCycles, kb.ikCycles,
+           (float)kb.ikRefCycles / (kb.ikCycles ? kb.ikCycles : 1));
+    printf("  trig (libm vs. poly)    %10u %7u %8.1fx\n", kb.trigRefCycles, kb.trigCycles,
+           (float)kb.trigRefCycles / (kb.trigCycles ? kb.trigCycles : 1));
+    printf("  max error: FK %.5f cm, IK %d%%\n\n", kb.fkMaxErrorCm, kb.ikMaxErrorPercent);
+
+    loadRecordingCsv(demo_picknplace);
+    size_t steps = recordingBuffer.size();
+    bench("playback step (5 servos)", 1000000, [steps](long)
+          {
+              if (!isPlaying || playStep >= steps)
+                  startPlayback();
+              simAdvanceMicros(21000);
+              controlTick(); });
+    return 0;
+}
+
+// --- STRESS ---
+static bool checkOutputRanges()
+{
+    for (const auto &w : simPwm.writes())
+    {
+        bool known = false;
+        for (int i = 0; i < NUM_SERVOS; i++)
+        {
+            if (servos[i].pin != w.channel)
+                continue;
+            known = true;
+            if (w.off < usToTicks(servos[i].minUs) || w.off > usToTicks(servos[i].maxUs))
+            {
+                printf("FAIL: channel %u tick %u outside [%d, %d]\n", w.channel, w.off,
+                       usToTicks(servos[i].minUs), usToTicks(servos[i].maxUs));
+                return false;
+            }
+        }
+        if (!known)
+        {
+            printf("FAIL: write to unused channel %u\n", w.channel);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Tick moveServoUs() puts out for a pulse width (once the profile settled)
+static uint16_t servoTicks(int servoIndex)
+{
+    return usToTicks(currentUs[servoIndex]);
+}
+
+// The exact frame and write counts below are checked with the motion
+// profile off (outputs follow at once) and playback holding every row
+static void setProfiles(bool on)
+{
+    motionProfileEnabled = on;
+    playbackMode = on ? PLAYBACK_INTERPOLATE : PLAYBACK_HOLD;
+}
+
+// Steps the shoulder and base across most of their range and samples the
+// wire every 20 ms: speed and acceleration stay inside the limits, the
+// outputs never pass the command and arrive in the trapezoid's time
+static bool checkProfile()
+{
+    setProfiles(true);
+    homeServos();
+    const int joints[2] = {0, 1};
+    const int targets[2] = {servos[0].minUs + 100, servos[1].maxUs - 100};
+    float startUs[2], expectedMs = 0;
+    for (int k = 0; k < 2; k++)
+    {
+        int j = joints[k];
+        startUs[k] = currentUs[j];
+        float d = fabsf(targets[k] - startUs[k]), v = servos[j].maxVelUsS, a = servos[j].maxAccUsS2;
+        float ms = d > v * v / a ? (d / v + v / a) * 1000.0f : 2.0f * sqrtf(d / a) * 1000.0f;
+        if (ms > expectedMs)
+            expectedMs = ms;
+        moveServoUs(j, targets[k]);
+    }
+
+    bool ok = true;
+    float prev[2] = {startUs[0], startUs[1]}, prevVel[2] = {0, 0}, maxVel[2] = {0, 0}, maxAcc[2] = {0, 0};
+    unsigned long start = halMillis();
+    int ticks = 0;
+    while (!servosSettled() && ticks < 10000)
+    {
+        simAdvanceMicros(1000);
+        controlTick();
+        if (++ticks % 20)
+            continue;
+        for (int k = 0; k < 2; k++)
+        {
+            int j = joints[k];
+            float vel = (outputUs[j] - prev[k]) / 0.02f;
+            float acc = fabsf(vel - prevVel[k]) / 0.02f;
+            maxVel[k] = fabsf(vel) > maxVel[k] ? fabsf(vel) : maxVel[k];
+            maxAcc[k] = acc > maxAcc[k] ? acc : maxAcc[k];
+            // Never past the command
+            ok = ok && (targets[k] - outputUs[j]) * (targets[k] - startUs[k]) >= 0;
+            prev[k] = outputUs[j];
+            prevVel[k] = vel;
+        }
+    }
+    unsigned long tookMs = halMillis() - start;
+    for (int k = 0; k < 2; k++)
+    {
+        int j = joints[k];
+        // 1 us rounding over a 20 ms window is 50 us/s of slack
+        ok = ok && maxVel[k] <= servos[j].maxVelUsS + 100.0f && maxAcc[k] <= servos[j].maxAccUsS2 + 5000.0f &&
+             simPwm.ticks(servos[j].pin) == servoTicks(j);
+    }
+    ok = ok && tookMs <= expectedMs + 20 && tookMs + 20 >= expectedMs;
+    printf("%-12s %lu ms (expected %.0f), shoulder %.0f us/s %.0f us/s^2 %s\n", "profile", tookMs, expectedMs,
+           maxVel[1], maxAcc[1], ok ? "OK" : "FAIL");
+    setProfiles(false);
+    return ok;
+}
+
+// Synchronized joint move over four joints with very different distances
+// and limits: every joint keeps the same fraction of its way, all arrive
+// in the planned time, and no joint exceeds its own limits
+static bool checkJointMove()
+{
+    setProfiles(true);
+    homeServos();
+    int target[NUM_SERVOS] = {servos[0].minUs + 50, servos[1].maxUs - 300, servos[2].startUs - 200,
+                              servos[3].startUs + 900, servos[4].maxUs};
+    int from[NUM_SERVOS];
+    for (int i = 0; i < NUM_SERVOS; i++)
+        from[i] = outputUs[i];
+    float plannedMs = startJointMove(target);
+
+    bool ok = true;
+    float worstSpread = 0;
+    float prev[NUM_SERVOS], prevVel[NUM_SERVOS] = {0, 0, 0, 0, 0};
+    for (int i = 0; i < NUM_SERVOS; i++)
+        prev[i] = from[i];
+    unsigned long start = halMillis();
+    int ticks = 0;
+    while ((jointMove.active || !servosSettled()) && ticks < 10000)
+    {
+        simAdvanceMicros(1000);
+        controlTick();
+        ticks++;
+        // Fraction of the way done, equal for all joints up to 1 us
+        float lo = 2, hi = -1;
+        for (int i = 0; i < NUM_SERVOS; i++)
+        {
+            float s = (outputUs[i] - from[i]) / (float)(target[i] - from[i]);
+            lo = s < lo ? s : lo;
+            hi = s > hi ? s : hi;
+        }
+        if (hi - lo > worstSpread)
+            worstSpread = hi - lo;
+        if (ticks % 20)
+            continue;
+        for (int i = 0; i < NUM_SERVOS; i++)
+        {
+            float vel = (outputUs[i] - prev[i]) / 0.02f;
+            ok = ok && fabsf(vel) <= servos[i].maxVelUsS + 100.0f &&
+                 fabsf(vel - prevVel[i]) / 0.02f <= servos[i].maxAccUsS2 + 5000.0f;
+            prev[i] = outputUs[i];
+            prevVel[i] = vel;
+        }
+    }
+    unsigned long tookMs = halMillis() - start;
+    for (int i = 0; i < NUM_SERVOS; i++)
+        ok = ok && outputUs[i] == target[i];
+    // Shortest joint travel is 300 us, 1 us of rounding is 0.0033 of it
+    ok = ok && worstSpread < 0.01f && tookMs <= plannedMs + 2 && tookMs + 2 >= plannedMs;
+    printf("%-12s %lu ms (planned %.0f), max progress spread %.4f %s\n", "joint move", tookMs, plannedMs,
+           worstSpread, ok ? "OK" : "FAIL");
+    setProfiles(false);
+    return ok;
+}
+
+// Joint move started while the shoulder still runs a profiled move the
+// other way: it brakes on the profile, turns once and arrives, never
+// jumping or exceeding its limits on the wire
+static bool checkJointRetarget()
+{
+    setProfiles(true);
+    homeServos();
+    moveServoUs(1, servos[1].maxUs - 100);
+    float before = 0;
+    for (int t = 0; t < 300; t++)
+    {
+        if (t == 280)
+            before = outputUs[1];
+        simAdvanceMicros(1000);
+        controlTick();
+    }
+    float movingUsS = (outputUs[1] - before) / 0.02f;
+
+    int target[NUM_SERVOS] = {servos[0].startUs + 400, servos[1].minUs + 100, 0, 0, 0};
+    float plannedMs = startJointMove(target, 0x03);
+
+    bool ok = movingUsS > 0.0f;
+    float prev = outputUs[1], prevVel = movingUsS;
+    int turns = 0, ticks = 0;
+    unsigned long start = halMillis();
+    while ((jointMove.active || !servosSettled()) && ticks < 10000)
+    {
+        simAdvanceMicros(1000);
+        controlTick();
+        if (++ticks % 20)
+            continue;
+        float vel = (outputUs[1] - prev) / 0.02f;
+        ok = ok && fabsf(vel) <= servos[1].maxVelUsS + 100.0f &&
+             fabsf(vel - prevVel) / 0.02f <= servos[1].maxAccUsS2 + 5000.0f;
+        if (vel * prevVel < 0.0f)
+            turns++;
+        prev = outputUs[1];
+        if (vel != 0.0f)
+            prevVel = vel;
+    }
+    unsigned long tookMs = halMillis() - start;
+    float brakeMs = movingUsS / servos[1].maxAccUsS2 * 1000.0f;
+    ok = ok && turns == 1 && outputUs[0] == target[0] && outputUs[1] == target[1] &&
+         tookMs + 40 >= plannedMs + brakeMs && tookMs <= plannedMs + brakeMs + 40;
+    printf("%-12s %lu ms (braking %.0f + planned %.0f), %d turn %s\n", "retarget", tookMs, brakeMs, plannedMs,
+           turns, ok ? "OK" : "FAIL");
+    setProfiles(false);
+    return ok;
+}
+
+// Recording storage: random trajectories (holds, small steps, jumps, full
+// range noise) decode exactly, at arrival times with jitter, rate changes
+// and dropouts every row keeps its time within the tolerance. Dense motion (the demos, one byte per row
+// and up) packs 5x and more. A teach-in at controller rate, the demo
+// motions with 10 s pauses in between (arm still ~40% of the time), packs
+// 10x and more until the buffer is full.
+static bool checkRecording()
+{
+    bool exact = true;
+    uint32_t worstTimeMs = 0;
+    srand(5);
+    for (int t = 0; t < 200 && exact; t++)
+    {
+        Recording rec;
+        std::vector<RecordedStep> ref;
+        std::vector<uint32_t> refMs;
+        uint16_t v[NUM_SERVOS] = {1500, 600, 2400, 1500, 600};
+        int mode = t % 4;
+        uint32_t at = rand(), rate = 20;
+        for (int i = 0; i < 3000; i++)
+        {
+            if (rand() % 200 == 0)
+                rate = 5 + rand() % 40;
+            at += rand() % 50 == 0 ? rand() % 500 : rate + rand() % 5 - 2;
+            for (int j = 0; j < NUM_SERVOS; j++)
+            {
+                int k = rand() % 10;
+                if (mode == 0)
+                    v[j] = rand() % 20000 + 1;
+                else if (k < mode)
+                    v[j] += rand() % 41 - 20;
+                else if (k == 9 && rand() % 5 == 0)
+                    v[j] = 500 + rand() % 2000;
+            }
+            RecordedStep step = {v[0], v[1], v[2], v[3], v[4]};
+            if (!rec.append(step, at))
+                break;
+            ref.push_back(step);
+            refMs.push_back(at);
+        }
+        Recording::Cursor cursor = rec.cursor();
+        RecordedStep step;
+        size_t n = 0;
+        while (cursor.next(step) && n < ref.size())
+        {
+            exact = exact && memcmp(&step, &ref[n], sizeof(step)) == 0;
+            uint32_t want = refMs[n] - refMs[0];
+            uint32_t off = cursor.timeMs() > want ? cursor.timeMs() - want : want - cursor.timeMs();
+            worstTimeMs = off > worstTimeMs ? off : worstTimeMs;
+            n++;
+        }
+        exact = exact && n == ref.size() && !cursor.next(step) && rec.size() == ref.size();
+    }
+
+    // Dense motion alone, 10 bytes per row before
+    const char *demos[] = {demo_hello, demo_picknplace, demo_dancing};
+    float worstDense = 1e9f;
+    for (const char *csv : demos)
+    {
+        loadRecordingCsv(csv);
+        float ratio = 10.0f * recordingBuffer.size() / recordingBuffer.bytes();
+        worstDense = ratio < worstDense ? ratio : worstDense;
+    }
+
+    // Packets every 20 ms with up to 2 ms of radio jitter, no time prefixes
+    setControlMode(MODE_CONTROLLER);
+    startRecording();
+    size_t rows = 0;
+    uint32_t jitterUs = 0;
+    auto packet = [&jitterUs](const struct_message &msg)
+    {
+        uint32_t next = rand() % 4001;
+        simAdvanceMicros(20000 - jitterUs + next);
+        jitterUs = next;
+        queueControllerInput(msg, halMillis());
+        controlTick();
+    };
+    for (int d = 0; isRecording; d = (d + 1) % 3)
+    {
+        struct_message msg = {};
+        char line[64];
+        const char *c = demos[d];
+        while (*c && isRecording)
+        {
+            size_t len = strcspn(c, "\n");
+            snprintf(line, sizeof(line), "%.*s", (int)len, c);
+            c += len + (c[len] ? 1 : 0);
+            int p[NUM_SERVOS];
+            if (sscanf(line, "%d,%d,%d,%d,%d", &p[0], &p[1], &p[2], &p[3], &p[4]) != 5)
+                continue;
+            msg = {(uint8_t)p[0], (uint8_t)p[1], (uint8_t)p[2], (uint8_t)p[3], p[4] > 50};
+            packet(msg);
+        }
+        for (int i = 0; i < 500 && isRecording; i++)
+            packet(msg);
+        rows = recordingBuffer.size();
+    }
+    float ratio = 10.0f * rows / recordingBuffer.bytes();
+
+    // Decode cost: whole buffer, per row
+    auto t0 = std::chrono::steady_clock::now();
+    Recording::Cursor cursor = recordingBuffer.cursor();
+    RecordedStep step;
+    uint32_t sum = 0;
+    while (cursor.next(step))
+        sum += step.base;
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+    benchSink += sum;
+
+    bool ok = exact && worstTimeMs <= RECORDING_TIME_TOLERANCE_MS && ratio >= 10.0f && worstDense >= 5.0f &&
+              cursor.position() == rows;
+    printf("%-12s %zu rows (%.0f s at 50 Hz, 2000 before), %.1fx teach-in, %.1fx dense, %.0f ns/row, "
+           "times within %u ms %s\n",
+           "recording", rows, rows / 50.0f, ratio, worstDense, ns / rows, worstTimeMs, ok ? "OK" : "FAIL");
+    clearRecording();
+    return ok;
+}
+
+// A smooth base motion recorded at 50 Hz with radio jitter and dropouts
+// plays back in its recorded time. Interpolated, the command at every
+// frame stays within a few us of the original curve; holding rows lags
+// it by up to a row (and a whole dropout).
+static float timedPlaybackError(int mode, uint32_t &tookMs)
+{
+    playbackMode = mode;
+    startPlayback();
+    uint32_t slots = frameLock.slots;
+    unsigned long start = 0;
+    float worst = 0;
+    while (isPlaying)
+    {
+        simAdvanceMicros(1000);
+        controlTick();
+        if (frameLock.slots == slots)
+            continue;
+        slots = frameLock.slots;
+        if (!start)
+            start = halMillis();
+        float t = (float)(halMillis() - start);
+        float want = 1500.0f + 800.0f * sinf(t * 6.2831853f / 4000.0f);
+        float err = fabsf(currentUs[0] - want);
+        worst = err > worst ? err : worst;
+    }
+    tookMs = halMillis() - start;
+    return worst;
+}
+
+static bool checkTimedPlayback()
+{
+    // Times are relative to the first row, so is the curve
+    clearRecording();
+    srand(9);
+    uint32_t at = 0, first = 0;
+    for (int i = 0; i < 400; i++)
+    {
+        at += 20 + rand() % 5 - 2;
+        if (i % 50 == 49)
+            at += 100; // Five packets lost
+        first = i == 0 ? at : first;
+        uint16_t base = (uint16_t)lroundf(1500.0f + 800.0f * sinf((at - first) * 6.2831853f / 4000.0f));
+        recordStep({base, 1500, 1500, 1500, 600}, at);
+    }
+    uint32_t recordedMs = recordingBuffer.durationMs();
+    uint32_t holdMs, lerpMs;
+    float holdErr = timedPlaybackError(PLAYBACK_HOLD, holdMs);
+    float lerpErr = timedPlaybackError(PLAYBACK_INTERPOLATE, lerpMs);
+    playbackMode = PLAYBACK_HOLD;
+
+    // Duration within one frame of the recording
+    bool ok = recordedMs == at - first && lerpErr <= 8.0f && holdErr > lerpErr &&
+              holdMs >= recordedMs && holdMs <= recordedMs + 20 && lerpMs >= recordedMs && lerpMs <= recordedMs + 20;
+    printf("%-12s %u ms recorded, played %u ms, %.1f us off the curve (holding rows %u ms, %.1f us) %s\n",
+           "timed play", recordedMs, lerpMs, lerpErr, holdMs, holdErr, ok ? "OK" : "FAIL");
+    clearRecording();
+    return ok;
+}
+
+// Ticks the control loop for ms milliseconds, the network task's slot
+// service every 5 ms
+static void runSlotService(uint32_t ms)
+{
+    for (uint32_t i = 0; i < ms; i++)
+    {
+        simAdvanceMicros(1000);
+        controlTick();
+        if (halMillis() % 5 == 0)
+            recordingStoreService();
+    }
+}
+
+static void collectRow(const RecordedStep &step, uint32_t, void *ctx)
+{
+    ((std::vector<RecordedStep> *)ctx)->push_back(step);
+}
+
+static void findSlot(const char *name, uint32_t bytes, void *ctx)
+{
+    if (strcmp(name, "teach") == 0)
+        *(uint32_t *)ctx = bytes;
+}
+
+// Slots: a take of random controller traffic three times the RAM buffer
+// goes to flash while RAM holds a few rows, decodes exactly from the file
+// and streams back in its recorded time without the read-ahead running
+// dry. A file cut mid-row (power lost) ends cleanly before that row.
+static bool checkSlots()
+{
+    bool ok = recordingStoreBegin() && slotRecordOpen("teach");
+    startSlotRecording();
+    setControlMode(MODE_CONTROLLER);
+    std::vector<RecordedStep> ref;
+    size_t maxRam = 0;
+    srand(11);
+    for (int i = 0; i < 10000 && isRecording; i++)
+    {
+        struct_message msg = {(uint8_t)(rand() % 101), (uint8_t)(rand() % 101), (uint8_t)(rand() % 101),
+                              (uint8_t)(rand() % 101), (rand() & 1) != 0};
+        queueControllerInput(msg, halMillis());
+        runSlotService(20);
+        ref.push_back({(uint16_t)currentUs[0], (uint16_t)currentUs[1], (uint16_t)currentUs[2],
+                       (uint16_t)currentUs[3], (uint16_t)currentUs[4]});
+        maxRam = recordingBuffer.bytes() > maxRam ? recordingBuffer.bytes() : maxRam;
+    }
+    ok = ok && isRecording;
+    uint32_t recordedMs = recordingBuffer.durationMs();
+    stopRecording();
+    for (int i = 0; i < 100 && slotBusy(); i++)
+        runSlotService(10);
+
+    std::vector<RecordedStep> rows;
+    uint32_t fileBytes = 0;
+    slotDecode("teach", collectRow, &rows);
+    slotList(findSlot, &fileBytes);
+    bool exact = !slotBusy() && rows.size() == ref.size() && fileBytes > 3 * RECORDING_MAX_BYTES;
+    for (size_t i = 0; exact && i < rows.size(); i++)
+        exact = memcmp(&rows[i], &ref[i], sizeof(RecordedStep)) == 0;
+
+    // Streamed playback, the service refilling the read-ahead
+    playbackMode = PLAYBACK_INTERPOLATE;
+    uint32_t starvedBefore = slotReader.starved;
+    ok = ok && slotPlayOpen("teach");
+    startSlotPlayback();
+    unsigned long start = halMillis();
+    while (isPlaying && halMillis() - start < recordedMs + 1000)
+        runSlotService(1);
+    uint32_t playedMs = halMillis() - start;
+    uint32_t starvedPlayed = slotReader.starved - starvedBefore;
+    bool played = !isPlaying && playStep == ref.size() && starvedPlayed == 0 &&
+                  currentUs[0] == ref.back().base &&
+                  currentUs[4] == ref.back().gripper && playedMs <= recordedMs + 2 * SERVO_FRAME_US / 1000;
+
+    // Without the service the ring runs dry: rows still come due and are
+    // counted, also once the ring is completely empty
+    ok = ok && slotPlayOpen("teach");
+    startSlotPlayback();
+    uint32_t dryBefore = slotReader.starved, dryLate = 0;
+    for (int t = 0; t < 4000; t++) // The ring holds about 2 s of these rows
+    {
+        if (t == 3900)
+            dryLate = slotReader.starved;
+        simAdvanceMicros(1000);
+        controlTick();
+    }
+    bool dryCounted = isPlaying && slotReader.starved > dryLate && dryLate > dryBefore;
+    isPlaying = false;
+    playbackMode = PLAYBACK_HOLD;
+
+    // Copy of the file without its last 3 bytes
+    uint8_t buf[256];
+    int in = halFileOpen("/rec/teach.rec", "r"), out = halFileOpen("/rec/cut.rec", "w");
+    int n;
+    std::vector<uint8_t> bytes;
+    while ((n = halFileRead(in, buf, sizeof(buf))) > 0)
+        bytes.insert(bytes.end(), buf, buf + n);
+    halFileWrite(out, bytes.data(), (int)bytes.size() - 3);
+    halFileClose(in);
+    halFileClose(out);
+    std::vector<RecordedStep> cut;
+    slotDecode("cut", collectRow, &cut);
+    bool cutOk = !cut.empty() && cut.size() < ref.size() && cut.size() + 3 >= ref.size();
+    for (size_t i = 0; cutOk && i < cut.size(); i++)
+        cutOk = memcmp(&cut[i], &ref[i], sizeof(RecordedStep)) == 0;
+    cutOk = cutOk && slotRemove("cut") && !slotDecode("cut", collectRow, &cut);
+
+    ok = ok && exact && played && dryCounted && cutOk;
+    printf("%-12s %zu rows, %u bytes on flash, %zu in RAM at most, played %u ms of %u, %u starved, dry %u %s\n",
+           "slots", ref.size(), fileBytes, maxRam, playedMs, recordedMs, starvedPlayed,
+           slotReader.starved - dryBefore, ok ? "OK" : "FAIL");
+    clearRecording();
+    return ok;
+}
+
+// ESP-NOW queue: a burst of packets while the control task is late fills
+// the queue, the rest is dropped and counted. The next tick applies the
+// queued ones in order and records them at their arrival times, not at the
+// time they were drained.
+static bool checkControllerQueue()
+{
+    setControlMode(MODE_CONTROLLER);
+    startRecording();
+    ControllerQueueStats before = controllerQueueStats;
+    const int burst = CONTROLLER_QUEUE_LEN + 4;
+    uint32_t t0 = halMillis();
+    auto start = std::chrono::steady_clock::now();
+    int queued = 0;
+    for (int k = 0; k < burst; k++)
+        queued += queueControllerInput({(uint8_t)(k * 5), 50, 50, 50, false}, t0 + k * 7) ? 1 : 0;
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    simAdvanceMicros(200000);
+    controlTick();
+
+    bool ok = queued == (int)CONTROLLER_QUEUE_LEN &&
+              controllerQueueStats.dropped - before.dropped == burst - CONTROLLER_QUEUE_LEN &&
+              controllerQueueStats.maxDepth >= CONTROLLER_QUEUE_LEN && recordingBuffer.size() == CONTROLLER_QUEUE_LEN;
+    Recording::Cursor cursor = recordingBuffer.cursor();
+    RecordedStep step;
+    for (int k = 0; ok && cursor.next(step); k++)
+        ok = step.base == percentToUs(0, k * 5) && cursor.timeMs() == (uint32_t)k * 7;
+    stopRecording();
+    printf("%-12s %d queued, %u dropped when full, arrival times kept, %.0f ns per packet in the callback %s\n",
+           "esp-now", queued, controllerQueueStats.dropped - before.dropped, ns / burst, ok ? "OK" : "FAIL");
+    clearRecording();
+    return ok;
+}
+
+// Worst joint of every row of in against keys interpolated at its time,
+// in units of unitUs: checked here on its own, not with the simplifier's
+// own measure
+static float keyframeError(const Recording &in, const Recording &keys, KeyframeUnit unit)
+{
+    std::vector<RecordedStep> k;
+    std::vector<uint32_t> kMs;
+    Recording::Cursor c = keys.cursor();
+    RecordedStep step;
+    while (c.next(step))
+    {
+        k.push_back(step);
+        kMs.push_back(c.timeMs());
+    }
+    float worst = 0;
+    size_t seg = 0;
+    c = in.cursor();
+    while (c.next(step))
+    {
+        uint32_t t = c.timeMs();
+        while (seg + 2 < k.size() && kMs[seg + 1] <= t)
+            seg++;
+        const uint16_t *a = &k[seg].base, *b = &k[seg + 1 < k.size() ? seg + 1 : seg].base;
+        const uint16_t *v = &step.base;
+        float f = kMs[seg + 1 < k.size() ? seg + 1 : seg] > kMs[seg]
+                      ? (float)(t - kMs[seg]) / (kMs[seg + 1] - kMs[seg])
+                      : 0.0f;
+        f = f > 1.0f ? 1.0f : f;
+        for (int j = 0; j < NUM_SERVOS; j++)
+        {
+            float e = fabsf(v[j] - lroundf(a[j] + (b[j] - (float)a[j]) * f)) / keyframeUnitUs(j, unit);
+            worst = e > worst ? e : worst;
+        }
+    }
+    return worst;
+}
+
+// Keyframes: the demos and a teach-in take (demo motions with 2 s
+// pauses, jittery packets) at 1% and 1 degree. Every row stays within
+// the tolerance (+ the half us playback rounds to) when the keyframes are
+// interpolated.
+static bool checkKeyframes()
+{
+    struct Take
+    {
+        const char *name;
+        Recording rec;
+    };
+    std::vector<Take> takes;
+    const char *names[] = {"hello", "picknplace", "dancing"};
+    for (const char *name : names)
+    {
+        loadRecordingCsv(demoByName(name));
+        takes.push_back({name, recordingBuffer});
+    }
+    setControlMode(MODE_CONTROLLER);
+    startRecording();
+    srand(3);
+    for (int d = 0; isRecording && d < 9; d++)
+    {
+        struct_message msg = {};
+        const char *c = demoByName(names[d % 3]);
+        while (*c && isRecording)
+        {
+            int p[NUM_SERVOS];
+            if (sscanf(c, "%d,%d,%d,%d,%d", &p[0], &p[1], &p[2], &p[3], &p[4]) == 5)
+            {
+                msg = {(uint8_t)p[0], (uint8_t)p[1], (uint8_t)p[2], (uint8_t)p[3], p[4] > 50};
+                simAdvanceMicros(18000 + rand() % 4001);
+                queueControllerInput(msg, halMillis());
+                controlTick();
+            }
+            c += strcspn(c, "\n");
+            c += *c ? 1 : 0;
+        }
+        for (int i = 0; i < 100 && isRecording; i++)
+        {
+            simAdvanceMicros(18000 + rand() % 4001);
+            queueControllerInput(msg, halMillis());
+            controlTick();
+        }
+    }
+    stopRecording();
+    takes.push_back({"teach-in", recordingBuffer});
+
+    bool ok = true;
+    const float tolerances[] = {2.0f, 2.0f};
+    const KeyframeUnit units[] = {KEYFRAME_PERCENT, KEYFRAME_DEGREES};
+    for (int u = 0; u < 2; u++)
+    {
+        for (const Take &take : takes)
+        {
+            Recording keys;
+            KeyframeResult r = simplifyRecording(take.rec, keys, tolerances[u], units[u]);
+            float err = keyframeError(take.rec, keys, units[u]);
+            float rounding = 0; // Playback rounds to whole us
+            for (int j = 0; j < RECORDING_JOINTS; j++)
+                rounding = fmaxf(rounding, 0.5f / keyframeUnitUs(j, units[u]));
+            bool good = r.complete && r.rowsOut == keys.size() && r.rowsIn >= 3 * r.rowsOut &&
+                        err <= tolerances[u] + rounding &&
+                        fabsf(err - r.maxDeviation) < 1e-4f && keys.durationMs() == take.rec.durationMs() &&
+                        r.smaller == (keys.bytes() < take.rec.bytes());
+            printf("%-12s %-10s %.0f%s: %5zu -> %4zu rows (%.1fx), %5zu -> %4zu bytes (%.1fx, %s), max %.2f %s\n",
+                   "keyframes", take.name, tolerances[u], units[u] == KEYFRAME_PERCENT ? "%" : " deg",
+                   r.rowsIn, r.rowsOut, (float)r.rowsIn / r.rowsOut, r.bytesIn, r.bytesOut,
+                   (float)r.bytesIn / r.bytesOut, r.smaller ? "applied" : "kept", r.maxDeviation,
+                   good ? "OK" : "FAIL");
+            ok = ok && good;
+        }
+    }
+    clearRecording();
+    return ok;
+}
+
+// Playback against a PCA9685 whose oscillator is 4% fast: with the HAL
+// calibrated to it, every write lands in the lead window before the frame
+// that uses it (next pulse, never mid-pulse), and no counter restart runs
+// into a frame. Uncalibrated, the slots drift off the real frame between
+// resyncs.
+static float frameLockOnTime(uint32_t halOscHz, float &meanLatencyUs, uint32_t &cuts)
+{
+    halSetOscillator(halOscHz);
+    FrameLockStats before = frameLock;
+    simPwm.clearLog();
+    loadRecordingCsv(demo_hello);
+    runPlayback();
+    int onTime = 0;
+    double latency = 0;
+    const auto &log = simPwm.writes();
+    for (const auto &w : log)
+    {
+        uint32_t gap = w.frameUs - w.timeUs;
+        onTime += gap > 0 && gap <= FRAME_LEAD_US ? 1 : 0;
+        latency += gap;
+    }
+    meanLatencyUs = log.empty() ? 0 : (float)(latency / log.size());
+    cuts = simPwm.cutPulses();
+    if (frameLock.missed != before.missed || frameLock.resyncs == before.resyncs)
+        return 0;
+    return log.empty() ? 0 : (float)onTime / log.size();
+}
+
+static bool checkFrameLock()
+{
+    const uint32_t trueOscHz = 26000000;
+    simPwm.setOscillator(trueOscHz);
+    float calibratedUs, nominalUs;
+    uint32_t calibratedCuts, nominalCuts;
+    float calibrated = frameLockOnTime(trueOscHz, calibratedUs, calibratedCuts);
+    float nominal = frameLockOnTime(0, nominalUs, nominalCuts);
+    simPwm.setOscillator(HAL_PCA9685_OSC_HZ);
+    halSetOscillator(0);
+
+    bool ok = calibrated == 1.0f && calibratedUs <= FRAME_LEAD_US && calibratedCuts == 0;
+    printf("%-12s %.0f%% on time, %.0f us to the pulse, %u cut (uncalibrated %.0f%%, %.0f us, %u cut) %s\n",
+           "frame lock", calibrated * 100, calibratedUs, calibratedCuts, nominal * 100, nominalUs, nominalCuts,
+           ok ? "OK" : "FAIL");
+    return ok;
+}
+
+static int runStress()
+{
+    simSetQuiet(true);
+    setProfiles(false);
+    bool ok = true;
+    const char *demos[] = {"hello", "picknplace", "dancing"};
+    for (const char *name : demos)
+    {
+        simPwm.clearLog();
+        loadRecordingCsv(demoByName(name));
+        size_t steps = recordingBuffer.size();
+        FrameStats before = frameStats;
+        long ticks = runPlayback();
+        bool inRange = checkOutputRanges();
+        // Every staged channel is either written or suppressed, and the
+        // outputs end on the last step
+        uint32_t writes = frameStats.writes - before.writes;
+        uint32_t suppressed = frameStats.suppressed - before.suppressed;
+        bool complete = writes == simPwm.writes().size() && writes + suppressed == steps * NUM_SERVOS;
+        for (int i = 0; i < NUM_SERVOS; i++)
+            complete = complete && simPwm.ticks(servos[i].pin) == servoTicks(i);
+        printf("%-12s %5zu steps %7ld ticks %6u writes %6u suppressed %s\n", name, steps, ticks, writes,
+               suppressed, (inRange && complete) ? "OK" : "FAIL");
+        ok = ok && inRange && complete;
+    }
+
+    // Frames: at most one burst per playback step, all channels of a frame
+    // stamped together
+    simPwm.clearLog();
+    loadRecordingCsv(demo_hello);
+    uint32_t framesBefore = frameStats.frames;
+    runPlayback();
+    uint32_t frames = frameStats.frames - framesBefore;
+    bool framesOk = frames <= recordingBuffer.size() && simPwm.bursts() >= frames;
+    const auto &log = simPwm.writes();
+    int sameStamp = 1;
+    for (size_t i = 1; i < log.size(); i++)
+    {
+        sameStamp = log[i].timeUs == log[i - 1].timeUs ? sameStamp + 1 : 1;
+        framesOk = framesOk && sameStamp <= NUM_SERVOS;
+    }
+    uint32_t singleUs = NUM_SERVOS * simI2cMicros(2 + 4);
+    printf("%-12s %5u frames %5u bursts, %u us/frame max (%u us as single writes) %s\n", "frames", frames,
+           simPwm.bursts(), frameStats.maxBusUs, singleUs, framesOk ? "OK" : "FAIL");
+    ok = ok && framesOk;
+
+    // Random controller traffic while recording, then replay it
+    simPwm.clearLog();
+    setControlMode(MODE_CONTROLLER);
+    startRecording();
+    srand(1);
+    for (int i = 0; i < 5000; i++)
+    {
+        struct_message msg = {(uint8_t)(rand() % 101), (uint8_t)(rand() % 101),
+                              (uint8_t)(rand() % 101), (uint8_t)(rand() % 101),
+                              (rand() & 1) != 0};
+        simAdvanceMicros(10000);
+        queueControllerInput(msg, halMillis());
+        controlTick();
+    }
+    stopRecording();
+    long ticks = runPlayback();
+    bool inRange = checkOutputRanges();
+    printf("%-12s %5zu steps %7ld ticks %6zu writes %s\n", "controller", recordingBuffer.size(),
+           ticks, simPwm.writes().size(), inRange ? "OK" : "FAIL");
+    ok = ok && inRange;
+
+    // IK sweep over a grid of targets
+    int reachable = 0, total = 0;
+    for (float x = -25; x <= 25; x += 0.5f)
+        for (float z = -5; z <= 30; z += 0.5f)
+        {
+            calculateIK(x, 5.0f, z, 0.0f);
+            reachable += ikReachable ? 1 : 0;
+            total++;
+        }
+    inRange = checkOutputRanges();
+    printf("%-12s %5d/%d reachable %s\n", "ik sweep", reachable, total, inRange ? "OK" : "FAIL");
+    ok = ok && inRange;
+
+    // Batch IK: a reachable circle plays through, an unreachable point stops early
+    std::vector<CartesianWaypoint> path(1000);
+    for (size_t i = 0; i < path.size(); i++)
+    {
+        float a = i * 6.2831853f / path.size();
+        path[i] = {14.0f + 3.0f * cosf(a), 3.0f * sinf(a), 12.0f, 0.0f, (uint8_t)(i < 500 ? 0 : 100)};
+    }
+    commitServoFrame(); // Flush the sweep's last pose
+    simPwm.clearLog();
+    Recording solved;
+    IkBatchResult batch = solvePathRecording(path.data(), path.size(), currentUs, solved);
+    playSolvedPath(solved);
+    FrameStats before = frameStats;
+    ticks = runPlayback();
+    bool batchOk = batch.firstUnreachable < 0 && batch.solved == path.size() &&
+                   frameStats.writes - before.writes + frameStats.suppressed - before.suppressed ==
+                       path.size() * NUM_SERVOS &&
+                   checkOutputRanges();
+    path[700].x = 60.0f;
+    std::vector<uint8_t> flags(path.size());
+    std::vector<RecordedStep> partial;
+    batch = solveIKBatch(path.data(), path.size(), partial, flags.data());
+    batchOk = batchOk && batch.firstUnreachable == 700 && partial.size() == 700 && flags[699] && !flags[700];
+    long stopAt = batch.firstUnreachable;
+
+    // Neither an unreachable nor an oversized path touches the recording
+    size_t kept = recordingBuffer.size();
+    batch = solvePathRecording(path.data(), path.size(), currentUs, solved);
+    bool keptOk = batch.firstUnreachable == 700 && batch.solved == 0;
+    std::vector<CartesianWaypoint> longPath;
+    for (int lap = 0; lap < 20; lap++)
+    {
+        longPath.insert(longPath.end(), path.begin(), path.begin() + 700);
+        longPath.insert(longPath.end(), path.rbegin() + 300, path.rend());
+    }
+    batch = solvePathRecording(longPath.data(), longPath.size(), currentUs, solved);
+    keptOk = keptOk && batch.tooLong && batch.firstUnreachable < 0 && batch.solved < longPath.size() &&
+             batch.solved == solved.size() && recordingBuffer.size() == kept;
+    batchOk = batchOk && keptOk;
+    printf("%-12s %5zu points %7ld ticks, early stop at %ld, %zu of %zu fit %s\n", "ik batch", path.size(),
+           ticks, stopAt, batch.solved, longPath.size(), batchOk ? "OK" : "FAIL");
+    ok = ok && batchOk;
+
+    // MOVEL with the output profile on: the tip on the wire stays on the
+    // line (within 1 us quantisation), no joint exceeds its limits (the
+    // line ramps up and down) and it arrives on time
+    setControlMode(MODE_WEB);
+    setProfiles(true);
+    calculateIK(12.0f, -4.0f, 6.0f, 0.0f);
+    while (!servosSettled())
+    {
+        simAdvanceMicros(1000);
+        controlTick();
+    }
+    Coord from = calculateFK();
+    linearSpeedCmS = 20.0f;
+    startLinearMove(16.0f, 5.0f, 10.0f, 0.0f);
+    float plannedMs = linearMove.durationMs;
+    unsigned long moveStart = halMillis();
+    float maxOffLine = 0;
+    int maxLagUs = 0; // Output behind the command
+    bool limitsOk = true;
+    float prevUs[4], prevVel[4] = {0, 0, 0, 0};
+    for (int j = 0; j < 4; j++)
+        prevUs[j] = outputUs[j];
+    for (int tick = 1; linearMove.active; tick++)
+    {
+        simAdvanceMicros(1000);
+        controlTick();
+        for (int j = 0; j < 4; j++)
+            maxLagUs = abs(outputUs[j] - currentUs[j]) > maxLagUs ? abs(outputUs[j] - currentUs[j]) : maxLagUs;
+        for (int j = 0; j < 4 && tick % 20 == 0; j++)
+        {
+            // 1 us rounding over a 20 ms window, as in checkJointMove()
+            float vel = (outputUs[j] - prevUs[j]) / 0.02f;
+            limitsOk = limitsOk && fabsf(vel) <= servos[j].maxVelUsS + 100.0f &&
+                       fabsf(vel - prevVel[j]) / 0.02f <= servos[j].maxAccUsS2 + 5000.0f;
+            prevUs[j] = outputUs[j];
+            prevVel[j] = vel;
+        }
+        Coord p = forwardKinematics(outputUs);
+        // Distance from the straight line from -> target
+        float ux = 16.0f - from.x, uy = 5.0f - from.y, uz = 10.0f - from.z;
+        float len = sqrtf(ux * ux + uy * uy + uz * uz);
+        float vx = p.x - from.x, vy = p.y - from.y, vz = p.z - from.z;
+        float cx = vy * uz - vz * uy, cy = vz * ux - vx * uz, cz = vx * uy - vy * ux;
+        float off = sqrtf(cx * cx + cy * cy + cz * cz) / len;
+        if (off > maxOffLine)
+            maxOffLine = off;
+    }
+    float expectedMs = sqrtf((16.0f - from.x) * (16.0f - from.x) + (5.0f - from.y) * (5.0f - from.y) +
+                             (10.0f - from.z) * (10.0f - from.z)) /
+                       20.0f * 1000.0f;
+    unsigned long tookMs = halMillis() - moveStart;
+    bool movelOk = maxOffLine < 0.1f && maxLagUs == 0 && limitsOk && plannedMs >= expectedMs &&
+                   tookMs >= plannedMs && tookMs < plannedMs + 2 * CARTESIAN_PERIOD_MS;
+    printf("%-12s %lu ms (planned %.0f, %.0f at full speed), max %.2f cm off line, %d us lag, limits %s, "
+           "%u overruns %s\n",
+           "movel", tookMs, plannedMs, expectedMs, maxOffLine, maxLagUs, limitsOk ? "kept" : "exceeded",
+           linearMove.overruns, movelOk ? "OK" : "FAIL");
+    ok = ok && movelOk;
+    setProfiles(false);
+
+    // A line through the base axis at this height leaves the workspace: it
+    // is refused before it starts. A fast line gets stretched to the joint
+    // profiles instead of lagging behind the line.
+    calculateIK(12.0f, 0.0f, 6.0f, 0.0f);
+    startLinearMove(-12.0f, 0.0f, 6.0f, 0.0f);
+    bool refused = !linearMove.active && !ikReachable;
+    calculateIK(12.0f, -4.0f, 6.0f, 0.0f);
+    from = calculateFK();
+    linearSpeedCmS = 100.0f;
+    startLinearMove(16.0f, 5.0f, 10.0f, 0.0f);
+    float fastMs = sqrtf((16.0f - from.x) * (16.0f - from.x) + (5.0f - from.y) * (5.0f - from.y) +
+                         (10.0f - from.z) * (10.0f - from.z)) /
+                   100.0f * 1000.0f;
+    bool stretched = linearMove.active && linearMove.durationMs > fastMs;
+    float stretchedMs = linearMove.durationMs;
+    stopCartesianMotion();
+
+    // Planned on a copy of the joints (outside the lock): only starts if
+    // the arm is still where the plan begins
+    int copy[4] = {currentUs[0], currentUs[1], currentUs[2], currentUs[3]};
+    LinePlan plan;
+    planLinearMove(copy, 14.0f, 2.0f, 12.0f, 0.0f, false, 4.0f, plan);
+    moveServoUs(0, currentUs[0] + 20);
+    bool staleRefused = !startPlannedLinearMove(plan) && !linearMove.active;
+    moveServoUs(0, copy[0]);
+    bool planStarted = startPlannedLinearMove(plan) && linearMove.active && linearMove.durationMs == plan.durationMs;
+    bool planOk = refused && stretched && staleRefused && planStarted;
+    printf("%-12s line through the base axis %s, %.0f ms line takes %.0f ms, stale plan %s %s\n", "movel plan",
+           refused ? "refused" : "started", fastMs, stretchedMs, staleRefused ? "refused" : "started",
+           planOk ? "OK" : "FAIL");
+    ok = ok && planOk;
+    stopCartesianMotion();
+    linearSpeedCmS = 4.0f;
+
+    // Pitch turns the short way across +/-180 (10 deg, not 350)
+    calculateIK(-19.0f, 0.0f, 14.0f, 175.0f);
+    startLinearMove(-19.0f, 0.0f, 14.0f, -175.0f);
+    float turnMs = linearMove.durationMs;
+    while (linearMove.active)
+    {
+        simAdvanceMicros(1000);
+        controlTick();
+    }
+    Coord turned = calculateFK();
+    float turnErr = fabsf(fmodf(turned.pitch + 175.0f + 540.0f, 360.0f) - 180.0f);
+    bool shortWay = turnMs < 2.0f * 10.0f / 45.0f * 1000.0f && turnErr < 0.5f; // The long way is 7.8 s
+
+    // On a CPU too slow for the IK budget the line solves on fewer frames
+    // and still arrives on time
+    calculateIK(12.0f, -4.0f, 6.0f, 0.0f);
+    startLinearMove(16.0f, 5.0f, 10.0f, 0.0f);
+    float slowPlannedMs = linearMove.durationMs;
+    uint8_t maxStride = 1;
+    unsigned long slowStart = halMillis();
+    simSetMicrosPerRead(1500);
+    while (linearMove.active)
+    {
+        simAdvanceMicros(1000);
+        controlTick();
+        maxStride = linearMove.stride > maxStride ? linearMove.stride : maxStride;
+    }
+    simSetMicrosPerRead(0);
+    unsigned long slowMs = halMillis() - slowStart;
+    Coord arrived = calculateFK();
+    bool budgetOk = maxStride > 1 && fabsf(arrived.x - 16.0f) < 0.1f && fabsf(arrived.z - 10.0f) < 0.1f &&
+                    slowMs < slowPlannedMs + 4 * CARTESIAN_PERIOD_MS;
+    printf("%-12s pitch 175 -> -175 in %.0f ms, slow IK: %u frames per solve, %lu ms %s\n", "movel turn", turnMs,
+           maxStride, slowMs, shortWay && budgetOk ? "OK" : "FAIL");
+    ok = ok && shortWay && budgetOk;
+
+    // Jog: tip follows the commanded velocity, and crossing the base axis
+    // (Jacobian singular at R = 0) never makes a joint jump
+    calculateIK(12.0f, 0.0f, 10.0f, 0.0f);
+    from = calculateFK();
+    startJog(2.0f, 1.0f, 0.0f, 0.0f, 2000);
+    while (jog.active)
+    {
+        simAdvanceMicros(1000);
+        controlTick();
+    }
+    Coord to = calculateFK();
+    float jogErr = sqrtf((to.x - from.x - 4.0f) * (to.x - from.x - 4.0f) + (to.y - from.y - 2.0f) * (to.y - from.y - 2.0f) +
+                         (to.z - from.z) * (to.z - from.z));
+    calculateIK(3.0f, 0.0f, 12.0f, -30.0f);
+    startJog(-2.0f, 0.0f, 0.0f, 0.0f, 3000);
+    int maxJump = 0;
+    float minDet = 1e9f;
+    while (jog.active)
+    {
+        int before[4] = {currentUs[0], currentUs[1], currentUs[2], currentUs[3]};
+        simAdvanceMicros(1000);
+        controlTick();
+        for (int j = 0; j < 4; j++)
+            if (abs(currentUs[j] - before[j]) > maxJump)
+                maxJump = abs(currentUs[j] - before[j]);
+        if (jog.manipulability < minDet)
+            minDet = jog.manipulability;
+    }
+    // 90 deg/s over one 20 ms period is at most ~25 us on the fastest servo
+    bool jogOk = jogErr < 0.2f && maxJump <= 25;
+    printf("%-12s %.2f cm off after 2 s, min |det J| %.1f, max step %d us %s\n", "jog", jogErr, minDet, maxJump,
+           jogOk ? "OK" : "FAIL");
+    ok = ok && jogOk;
+
+    // FK cache: repeated writes of the same pulse keep the cached pose,
+    // any real change is picked up and published to cachedFK()
+    uint32_t version = jointVersion;
+    for (int j = 0; j < 4; j++)
+        moveServoUs(j, currentUs[j]);
+    bool cacheOk = jointVersion == version;
+    moveServo(1, servoPercent(1) < 50 ? servoPercent(1) + 10 : servoPercent(1) - 10);
+    controlTick();
+    Coord fresh = forwardKinematics(currentUs), cached = cachedFK();
+    cacheOk = cacheOk && jointVersion != version && fresh.x == cached.x && fresh.z == cached.z;
+    printf("%-12s version %u %s\n", "fk cache", (unsigned)jointVersion, cacheOk ? "OK" : "FAIL");
+    ok = ok && cacheOk;
+
+    // Calibration table: angle <-> pulse width round trips over the whole
+    // range, extended end segments included
+    float worstRoundTrip = 0;
+    for (int j = 0; j < 4; j++)
+        for (float u = servos[j].minUs - 200.0f; u <= servos[j].maxUs + 200.0f; u += 0.25f)
+        {
+            float back = angleToUs(j, usToAngle(j, u));
+            if (fabsf(back - u) > worstRoundTrip)
+                worstRoundTrip = fabsf(back - u);
+        }
+    bool calOk = worstRoundTrip < 0.01f;
+    printf("%-12s max round trip error %.4f us %s\n", "calibration", worstRoundTrip, calOk ? "OK" : "FAIL");
+    ok = ok && calOk;
+
+    // Nearest reachable: FK of the executed pose matches the reported pose and error
+    float worstMismatch = 0;
+    int relaxedExact = 0;
+    const float far[][4] = {{19.5f, 0, 15.5f, 0}, {30, 5, 10, 0}, {25, -10, 5, 0}, {10, 10, 28, 60}, {18, 3, 20, 20}};
+    for (const auto &t : far)
+    {
+        for (int relax = 0; relax < 2; relax++)
+        {
+            IkProjection proj = calculateIK(t[0], t[1], t[2], t[3], relax != 0);
+            Coord p = calculateFK();
+            float dx = p.x - proj.reached.x, dy = p.y - proj.reached.y, dz = p.z - proj.reached.z;
+            float mismatch = sqrtf(dx * dx + dy * dy + dz * dz);
+            float ex = t[0] - proj.reached.x, ey = t[1] - proj.reached.y, ez = t[2] - proj.reached.z;
+            mismatch += fabsf(sqrtf(ex * ex + ey * ey + ez * ez) - proj.errorCm);
+            if (mismatch > worstMismatch)
+                worstMismatch = mismatch;
+            if (proj.pitchRelaxed && proj.errorCm == 0)
+                relaxedExact++;
+        }
+    }
+    // Whole-microsecond joints put the executed tip well under 1 mm off
+    bool nearestOk = worstMismatch < 0.1f && relaxedExact > 0 && !ikReachable;
+    printf("%-12s max mismatch %.2f cm, %d exact via pitch relax %s\n", "ik nearest", worstMismatch,
+           relaxedExact, nearestOk ? "OK" : "FAIL");
+    ok = ok && nearestOk;
+
+    // IK branches: every solution is inside the servo ranges and matches FK
+    int solvable = 0, behind = 0, badSolution = 0;
+    srand(3);
+    for (int i = 0; i < 200000; i++)
+    {
+        float x = (rand() % 5000) / 100.0f - 25.0f;
+        float y = (rand() % 5000) / 100.0f - 25.0f;
+        float z = (rand() % 4000) / 100.0f - 10.0f;
+        float p = (rand() % 360) - 180.0f;
+        int pos[4];
+        if (!inverseKinematics(x, y, z, p, pos, currentUs))
+            continue;
+        solvable++;
+        if (x < 0 && fabsf(y) < fabsf(x))
+            behind++;
+        Coord c = forwardKinematics(pos);
+        float err = sqrtf((c.x - x) * (c.x - x) + (c.y - y) * (c.y - y) + (c.z - z) * (c.z - z));
+        for (int j = 0; j < 4; j++)
+            if (pos[j] < servos[j].minUs || pos[j] > servos[j].maxUs)
+                err = 1e9f;
+        // Whole-microsecond joints put the tip well under 1 mm off
+        if (err > 0.1f)
+            badSolution++;
+    }
+    printf("%-12s %5d solvable (%d behind the base), %d bad %s\n", "ik branches", solvable, behind,
+           badSolution, badSolution == 0 ? "OK" : "FAIL");
+    ok = ok && badSolution == 0;
+
+    // IK grid must be conservative: grid-reachable targets solve exactly,
+    // close to the seed
+    int gridReachable = 0, gridSolvable = 0, falsePositive = 0;
+    float maxSeedErr = 0;
+    srand(2);
+    for (int i = 0; i < 200000; i++)
+    {
+        float x = (rand() % 5000) / 100.0f - 25.0f;
+        float y = (rand() % 5000) / 100.0f - 25.0f;
+        float z = (rand() % 4000) / 100.0f - 10.0f;
+        float p = (rand() % 180) - 90.0f;
+        int pos[4];
+        bool solvable = inverseKinematics(x, y, z, p, pos);
+        gridSolvable += solvable;
+        if (ikGridReachableExact(x, y, z, p) != solvable)
+            falsePositive++;
+        float seed[4];
+        if (!ikGridLookup(x, y, z, p, seed))
+            continue;
+        gridReachable++;
+        if (!solvable)
+        {
+            falsePositive++;
+            continue;
+        }
+        for (int j = 0; j < 4; j++)
+            maxSeedErr = fmaxf(maxSeedErr, fabsf(seed[j] - pos[j]));
+    }
+    // Misses are all within about a cell of the boundary, where the exact IK decides
+    bool gridOk = falsePositive == 0 && maxSeedErr < 100.0f && gridReachable * 10 > gridSolvable * 7;
+    printf("%-12s %5d of %d solvable grid-reachable, %d not solvable, seeds within %.0f us %s\n", "ik grid",
+           gridReachable, gridSolvable, falsePositive, maxSeedErr, gridOk ? "OK" : "FAIL");
+    ok = ok && gridOk;
+
+    ok = checkProfile() && ok;
+    ok = checkJointMove() && ok;
+    ok = checkJointRetarget() && ok;
+    ok = checkFrameLock() && ok;
+    ok = checkRecording() && ok;
+    ok = checkTimedPlayback() && ok;
+    ok = checkSlots() && ok;
+    ok = checkControllerQueue() && ok;
+    ok = checkKeyframes() && ok;
+
+    // I2C: self-test settles on the fastest working clock, a NACK mid-run
+    // drops one step and the frame still lands. Last, halBegin() resets the
+    // simulated PCA9685.
+    simSetI2cMaxClock(400000);
+    halBegin();
+    homeServos();
+    uint32_t fastUs = frameStats.lastBusUs;
+    HalBusStatus bus = halBusStatus();
+    bool busOk = bus.clockHz == 400000 && bus.fallbacks == 1;
+    simFailI2c(1);
+    moveServo(1, servoPercent(1) < 50 ? servoPercent(1) + 5 : servoPercent(1) - 5);
+    commitServoFrame();
+    bus = halBusStatus();
+    busOk = busOk && bus.clockHz == 100000 && bus.errors == 2 &&
+            simPwm.ticks(servos[1].pin) == servoTicks(1);
+    printf("%-12s %u us/frame at 400 kHz, now %u Hz after %u errors %s\n", "i2c", fastUs, bus.clockHz, bus.errors,
+           busOk ? "OK" : "FAIL");
+    ok = ok && busOk;
+
+    // A NACK at 100 kHz (no slower clock left) loses the burst. Every frame
+    // of a move is lost here, the last one too: its pulse is not taken as
+    // written and goes out with the next frame, which has nothing new
+    uint32_t lostBefore = frameStats.lost;
+    moveServo(2, servoPercent(2) < 50 ? servoPercent(2) + 5 : servoPercent(2) - 5);
+    while (!servosSettled())
+    {
+        simFailI2c(1);
+        commitServoFrame();
+    }
+    bool stale = simPwm.ticks(servos[2].pin) != servoTicks(2);
+    commitServoFrame();
+    bool retried = stale && simPwm.ticks(servos[2].pin) == servoTicks(2);
+    printf("%-12s %u channel writes lost at %u Hz, last pulse %s on the next frame %s\n", "i2c retry",
+           frameStats.lost - lostBefore, halBusStatus().clockHz, retried ? "written" : "stale",
+           retried ? "OK" : "FAIL");
+    ok = ok && retried;
+
+    printf(ok ? "STRESS PASSED\n" : "STRESS FAILED\n");
+    return ok ? 0 : 1;
+}
+
+// --- TRACE ---
+static int runTrace(const char *name)
+{
+    const char *csv = demoByName(name);
+    if (!csv)
+    {
+        printf("Unknown demo: %s\n", name);
+        return 1;
+    }
+    simPwm.reset();
+    loadRecordingCsv(csv);
+    runPlayback();
+    printf("time_us,channel,on,off\n");
+    for (const auto &w : simPwm.writes())
+        printf("%u,%u,%u,%u\n", w.timeUs, w.channel, w.on, w.off);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    halBegin();
+    homeServos();
+
+    const char *cmd = argc > 1 ? argv[1] : "bench";
+    if (strcmp(cmd, "bench") == 0)
+        return runBench();
+    if (strcmp(cmd, "stress") == 0)
+        return runStress();
+    if (strcmp(cmd, "trace") == 0 && argc > 2)
+        return runTrace(argv[2]);
+
+    printf("usage: %s [bench|stress|trace <hello|picknplace|dancing>]\n", argv[0]);
+    return 1;
+}
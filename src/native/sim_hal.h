@@ -0,0 +1,79 @@
+#ifndef SIM_HAL_H
+#define SIM_HAL_H
+
+#include <stdint.h>
+#include <vector>
+
+// ================= SIMULATED HARDWARE (native builds) =================
+
+// Simulated PCA9685: keeps the current value of all 16 channels and records
+// every write it is sent, stamped with the simulated clock. Its frame runs
+// on its own (true) oscillator, which the HAL only knows as well as it was
+// calibrated.
+class SimPCA9685
+{
+public:
+    struct Write
+    {
+        uint32_t timeUs;
+        uint8_t channel;
+        uint16_t on;
+        uint16_t off;
+        uint32_t frameUs; // Start of the frame (pulse) that first uses it
+    };
+
+    void setPWM(uint8_t channel, uint16_t on, uint16_t off);
+    void reset();
+    void clearLog(); // Forget writes, bursts and cuts, keep the channel values
+
+    // Frame timing: prescaler as written by the HAL, counter restarted at us
+    void setOscillator(uint32_t hz) { oscHz = hz; }
+    void startFrames(uint8_t prescaler, uint32_t us);
+    // Sleep at stopUs, RESTART at us: a frame start in between is a pulse
+    // the chip cut or dropped
+    void stopFrame(uint32_t us);
+    void restartFrame(uint32_t us);
+    uint32_t cutPulses() const { return cutCount; }
+    double framePeriodUs() const { return (prescale + 1) * 4096.0 * 1e6 / oscHz; }
+    // First frame start at or after us
+    uint32_t nextFrameUs(uint32_t us) const;
+
+    uint16_t ticks(uint8_t channel) const { return offTicks[channel]; }
+    const std::vector<Write> &writes() const { return writeLog; }
+    void setLogging(bool enabled) { logging = enabled; }
+    uint32_t bursts() const { return burstCount; }
+    void countBurst() { burstCount++; }
+
+private:
+    uint16_t offTicks[16] = {0};
+    std::vector<Write> writeLog;
+    bool logging = true;
+    uint32_t burstCount = 0;
+    uint32_t oscHz = 25000000;
+    uint8_t prescale = 121;
+    uint32_t originUs = 0;
+    bool stopped = false;
+    uint32_t stopUs = 0;
+    uint32_t cutCount = 0;
+};
+
+extern SimPCA9685 simPwm;
+
+// Bus time of an I2C transfer of this many bytes at the simulated clock
+uint32_t simI2cMicros(uint32_t bytes);
+
+// I2C faults: clocks above maxHz fail, and the next n transactions NACK.
+// halBegin() picks its clock against these.
+void simSetI2cMaxClock(uint32_t hz);
+void simFailI2c(uint32_t transactions);
+
+// Simulated clock: only moves when the host program advances it, and by
+// perRead on every halMicros() (a slow CPU, 0 = off)
+void simSetMicros(uint32_t us);
+void simAdvanceMicros(uint32_t us);
+void simSetMicrosPerRead(uint32_t perRead);
+
+// Silence halLog() output (benchmarks)
+void simSetQuiet(bool quiet);
+
+#endif
@@ -0,0 +1,338 @@
+#include "recording.h"
+#include <atomic>
+
+static const uint8_t ROW_EXTENDED = 0xFF; // Step row with 4 escapes can't happen, means "extended"
+static const uint8_t ROW_RUN = 0x80;
+static const uint8_t ROW_TIME = 0x40;
+static const uint8_t RUN_MAX = 0x7F; // r + 1 = 128 rows
+static const uint8_t CODE_ZERO = 0;
+static const uint8_t CODE_UP = 1;
+static const uint8_t CODE_DOWN = 2;
+static const uint8_t CODE_VARINT = 3;
+
+// Unique over all recordings (and tasks), so a copy assigned over a
+// recording never looks like the take a cursor or a copy was made from
+static std::atomic<uint32_t> lastGeneration{0};
+
+static void toArray(const RecordedStep &s, uint16_t *v)
+{
+    v[0] = s.base;
+    v[1] = s.shoulder;
+    v[2] = s.elbow;
+    v[3] = s.wrist;
+    v[4] = s.gripper;
+}
+
+static void fromArray(const uint16_t *v, RecordedStep &s)
+{
+    s = {v[0], v[1], v[2], v[3], v[4]};
+}
+
+// Zigzag keeps small negative deltas small: 0, -1, 1, -2 -> 0, 1, 2, 3
+static size_t putVarint(uint8_t *out, int16_t d)
+{
+    uint32_t z = (((uint32_t)d << 1) ^ (uint32_t)(d >> 15)) & 0xFFFF;
+    size_t n = 0;
+    while (z >= 0x80)
+    {
+        out[n++] = (uint8_t)(z | 0x80);
+        z >>= 7;
+    }
+    out[n++] = (uint8_t)z;
+    return n;
+}
+
+static int16_t getVarint(const uint8_t *data, size_t &pos)
+{
+    uint32_t z = 0;
+    int shift = 0;
+    uint8_t b;
+    do
+    {
+        b = data[pos++];
+        z |= (uint32_t)(b & 0x7F) << shift;
+        shift += 7;
+    } while (b & 0x80);
+    return (int16_t)((z >> 1) ^ (0u - (z & 1)));
+}
+
+static size_t putUvarint(uint8_t *out, uint32_t v)
+{
+    size_t n = 0;
+    while (v >= 0x80)
+    {
+        out[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (uint8_t)v;
+    return n;
+}
+
+static uint32_t getUvarint(const uint8_t *data, size_t &pos)
+{
+    uint32_t v = 0;
+    int shift = 0;
+    uint8_t b;
+    do
+    {
+        b = data[pos++];
+        v |= (uint32_t)(b & 0x7F) << shift;
+        shift += 7;
+    } while (b & 0x80);
+    return v;
+}
+
+// --- WRITER ---
+void Recording::clear()
+{
+    data.clear();
+    rows = 0;
+    spilledBytes = 0;
+    generation = ++lastGeneration;
+    runAt = SIZE_MAX;
+    repeated = false;
+    startMs = 0;
+    time = 0;
+    period = RECORDING_PERIOD_MS;
+    timeTolerance = RECORDING_TIME_TOLERANCE_MS;
+    anchorMs = 0;
+    anchorRow = 0;
+    for (int j = 0; j < RECORDING_JOINTS; j++)
+    {
+        last[j] = 0;
+        delta[j] = 0;
+        step[j] = 0;
+    }
+}
+
+// Step row for d, 0 if it needs an extended row (gripper moved, or all
+// four joints escaped)
+static size_t encodeSteps(const int16_t *d, const uint16_t *step, uint8_t *row)
+{
+    if (d[RECORDING_JOINTS - 1])
+        return 0;
+    uint8_t codes = 0;
+    size_t len = 1;
+    for (int j = 0; j < 4; j++)
+    {
+        uint8_t code = CODE_VARINT;
+        if (d[j] == 0)
+            code = CODE_ZERO;
+        else if (step[j] && d[j] == (int16_t)step[j])
+            code = CODE_UP;
+        else if (step[j] && d[j] == -(int16_t)step[j])
+            code = CODE_DOWN;
+        else
+            len += putVarint(row + len, d[j]);
+        codes |= code << (2 * j);
+    }
+    if (codes == ROW_EXTENDED)
+        return 0;
+    row[0] = codes;
+    return len;
+}
+
+static size_t encodeFull(const int16_t *d, uint8_t *row)
+{
+    size_t len = 2;
+    uint8_t mask = 0;
+    for (int j = 0; j < RECORDING_JOINTS; j++)
+    {
+        if (!d[j])
+            continue;
+        mask |= 1 << j;
+        len += putVarint(row + len, d[j]);
+    }
+    row[0] = ROW_EXTENDED;
+    row[1] = mask;
+    return len;
+}
+
+bool Recording::append(const RecordedStep &s)
+{
+    return append(s, startMs + time + (rows ? period : 0));
+}
+
+bool Recording::append(const RecordedStep &s, uint32_t timeMs)
+{
+    // Time prefix when the arrival is off the predicted time by more than
+    // the tolerance; the new period is the mean since the last one
+    uint8_t prefix[2 + 2 * 5];
+    size_t prefixLen = 0;
+    uint32_t rowTime = 0, newPeriod = period;
+    if (rows > 0)
+    {
+        int32_t since = (int32_t)(timeMs - startMs);
+        uint32_t rel = since > (int32_t)time ? (uint32_t)since : time; // Never backwards
+        rowTime = time + period;
+        int32_t err = (int32_t)(rel - rowTime);
+        if (err > (int32_t)timeTolerance || err < -(int32_t)timeTolerance)
+        {
+            size_t n = rows - anchorRow;
+            newPeriod = (uint32_t)((rel - anchorMs + n / 2) / n);
+            prefix[prefixLen++] = ROW_EXTENDED;
+            prefix[prefixLen++] = ROW_TIME;
+            prefixLen += putUvarint(prefix + prefixLen, rel - time);
+            prefixLen += putUvarint(prefix + prefixLen, newPeriod);
+            rowTime = rel;
+        }
+    }
+
+    uint16_t v[RECORDING_JOINTS];
+    toArray(s, v);
+    int16_t d[RECORDING_JOINTS];
+    bool same = rows > 0;
+    for (int j = 0; j < RECORDING_JOINTS; j++)
+    {
+        d[j] = (int16_t)(v[j] - last[j]);
+        same = same && d[j] == delta[j];
+    }
+
+    // Worst case: extended header + 5 varints of 3 bytes
+    uint8_t row[2 + 3 * RECORDING_JOINTS];
+    size_t len = 0;
+    bool growRun = false, startRun = false;
+    if (same && !prefixLen && runAt != SIZE_MAX && (data[runAt] & RUN_MAX) < RUN_MAX)
+    {
+        growRun = true;
+    }
+    else
+    {
+        len = encodeSteps(d, step, row);
+        if (!len)
+            len = encodeFull(d, row);
+        // A second repeat in a row likely starts a longer stretch
+        if (same && (len > 2 || repeated))
+        {
+            row[0] = ROW_EXTENDED;
+            row[1] = ROW_RUN;
+            len = 2;
+            startRun = true;
+        }
+    }
+
+    if (data.size() + prefixLen + len > RECORDING_MAX_BYTES)
+        return false;
+    if (growRun)
+        data[runAt]++;
+    if (len)
+    {
+        // Grow in steps, but never past the cap
+        if (data.size() + prefixLen + len > data.capacity())
+        {
+            size_t cap = data.capacity() < 256 ? 256 : data.capacity() * 2;
+            data.reserve(cap < RECORDING_MAX_BYTES ? cap : RECORDING_MAX_BYTES);
+        }
+        data.insert(data.end(), prefix, prefix + prefixLen);
+        runAt = startRun ? data.size() + 1 : SIZE_MAX;
+        data.insert(data.end(), row, row + len);
+    }
+    if (rows == 0)
+        startMs = timeMs;
+    if (prefixLen)
+    {
+        period = newPeriod;
+        anchorMs = rowTime;
+        anchorRow = rows;
+    }
+    time = rowTime;
+    for (int j = 0; j < RECORDING_JOINTS; j++)
+    {
+        last[j] = v[j];
+        delta[j] = d[j];
+        if (d[j])
+            step[j] = (uint16_t)(d[j] < 0 ? -d[j] : d[j]);
+    }
+    repeated = same;
+    rows++;
+    return true;
+}
+
+void Recording::spill(size_t n)
+{
+    n = n < data.size() ? n : data.size();
+    data.erase(data.begin(), data.begin() + n);
+    // A run byte that left can't count up any more, the next repeat
+    // starts a new run
+    if (runAt != SIZE_MAX)
+        runAt = runAt >= n ? runAt - n : SIZE_MAX;
+    spilledBytes += n;
+    generation = ++lastGeneration;
+}
+
+// --- READER ---
+Recording::Cursor Recording::cursor() const
+{
+    Cursor c;
+    c.rec = spilledBytes ? nullptr : this;
+    c.generation = generation;
+    return c;
+}
+
+bool Recording::Cursor::next(RecordedStep &out)
+{
+    if (!rec || generation != rec->generation)
+        return false;
+    if (!dec.inRun() && pos >= rec->data.size())
+        return false;
+    dec.next(rec->data.data(), pos, out);
+    return true;
+}
+
+void RecordingDecoder::next(const uint8_t *data, size_t &pos, RecordedStep &out)
+{
+    uint32_t dt = period;
+    if (run)
+    {
+        run--;
+    }
+    else
+    {
+        uint8_t h = data[pos++];
+        if (h == ROW_EXTENDED && data[pos] == ROW_TIME)
+        {
+            pos++;
+            dt = getUvarint(data, pos);
+            period = getUvarint(data, pos);
+            h = data[pos++];
+        }
+        if (h != ROW_EXTENDED)
+        {
+            for (int j = 0; j < 4; j++)
+            {
+                uint8_t code = (h >> (2 * j)) & 3;
+                if (code == CODE_ZERO)
+                    delta[j] = 0;
+                else if (code == CODE_UP)
+                    delta[j] = (int16_t)step[j];
+                else if (code == CODE_DOWN)
+                    delta[j] = -(int16_t)step[j];
+                else
+                    delta[j] = getVarint(data, pos);
+            }
+            delta[RECORDING_JOINTS - 1] = 0;
+        }
+        else
+        {
+            uint8_t x = data[pos++];
+            if (x & ROW_RUN)
+            {
+                run = x & RUN_MAX; // This row is the first of r + 1
+            }
+            else
+            {
+                for (int j = 0; j < RECORDING_JOINTS; j++)
+                    delta[j] = (x & (1 << j)) ? getVarint(data, pos) : 0;
+            }
+        }
+    }
+    for (int j = 0; j < RECORDING_JOINTS; j++)
+    {
+        last[j] = (uint16_t)(last[j] + delta[j]);
+        if (delta[j])
+            step[j] = (uint16_t)(delta[j] < 0 ? -delta[j] : delta[j]);
+    }
+    fromArray(last, out);
+    time = row ? time + dt : 0;
+    row++;
+}
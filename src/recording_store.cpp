@@ -0,0 +1,344 @@
+#include "recording_store.h"
+#include "arm_control.h"
+#include "hal.h"
+#include "spsc_ring.h"
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+static const uint8_t SLOT_MAGIC[4] = {'A', 'R', 'C', '1'};
+static const char *SLOT_DIR = "/rec";
+static const char *SLOT_EXT = ".rec";
+
+// Control task -> network task: the take being recorded
+static SpscRing<uint8_t, SLOT_RING_BYTES> writeRing;
+static std::atomic<bool> writeDone{false}; // Set after the last byte of a take
+// Network task -> control task: the slot being played
+static SpscRing<uint8_t, SLOT_RING_BYTES> readRing;
+static std::atomic<bool> readEnd{false}; // Set after the last byte of the file
+
+// Network task side
+static int writeFile = -1;
+static int readFile = -1;
+static uint32_t lastSyncMs = 0;
+static bool writeFailed = false;
+static char current[SLOT_NAME_MAX + 1] = "";
+
+// Control task side
+SlotReader slotReader;
+static bool slotWriting = false;
+static bool slotEnding = false;
+static std::vector<uint8_t> slotTail; // Rest of a stopped take, ring was full
+static size_t slotTailPos = 0;
+
+static void slotPath(const char *name, char *path, size_t size)
+{
+    snprintf(path, size, "%s/%s%s", SLOT_DIR, name, SLOT_EXT);
+}
+
+bool slotNameValid(const char *name)
+{
+    size_t n = strlen(name);
+    if (n == 0 || n > (size_t)SLOT_NAME_MAX)
+        return false;
+    for (size_t i = 0; i < n; i++)
+    {
+        char c = name[i];
+        bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' ||
+                  c == '_';
+        if (!ok)
+            return false;
+    }
+    return true;
+}
+
+static int openSlot(const char *name, const char *mode)
+{
+    if (!slotNameValid(name))
+        return -1;
+    char path[48];
+    slotPath(name, path, sizeof(path));
+    int f = halFileOpen(path, mode);
+    if (f < 0)
+        return -1;
+    uint8_t magic[sizeof(SLOT_MAGIC)];
+    bool ok = mode[0] == 'w' ? halFileWrite(f, SLOT_MAGIC, sizeof(magic)) == (int)sizeof(magic)
+                             : halFileRead(f, magic, sizeof(magic)) == (int)sizeof(magic) &&
+                                   memcmp(magic, SLOT_MAGIC, sizeof(magic)) == 0;
+    if (!ok)
+    {
+        halFileClose(f);
+        return -1;
+    }
+    return f;
+}
+
+// --- NETWORK TASK ---
+bool recordingStoreBegin()
+{
+    return halFileBegin();
+}
+
+static void fillReadAhead()
+{
+    uint8_t buf[256];
+    while (readFile >= 0 && readRing.space() > 0)
+    {
+        size_t want = readRing.space() < sizeof(buf) ? readRing.space() : sizeof(buf);
+        int n = halFileRead(readFile, buf, (int)want);
+        if (n <= 0)
+        {
+            halFileClose(readFile);
+            readFile = -1;
+            readEnd.store(true, std::memory_order_release);
+            break;
+        }
+        readRing.push(buf, (size_t)n);
+    }
+}
+
+void recordingStoreService()
+{
+    if (writeFile >= 0)
+    {
+        // Done before the bytes: once it is set, the whole take is in the ring
+        bool done = writeDone.load(std::memory_order_acquire);
+        uint8_t buf[256];
+        size_t n;
+        bool wrote = false;
+        while ((n = writeRing.pop(buf, sizeof(buf))) > 0)
+        {
+            if (halFileWrite(writeFile, buf, (int)n) != (int)n && !writeFailed)
+            {
+                writeFailed = true;
+                halLog("Slot write failed, flash full?");
+            }
+            wrote = true;
+        }
+        uint32_t now = halMillis();
+        if (done)
+        {
+            halFileClose(writeFile);
+            writeFile = -1;
+        }
+        else if (wrote && now - lastSyncMs >= SLOT_SYNC_MS)
+        {
+            halFileSync(writeFile);
+            lastSyncMs = now;
+        }
+    }
+    fillReadAhead();
+}
+
+bool slotRecordOpen(const char *name)
+{
+    if (slotBusy())
+        return false;
+    int f = openSlot(name, "w");
+    if (f < 0)
+        return false;
+    writeRing.reset();
+    writeDone.store(false, std::memory_order_relaxed);
+    writeFile = f;
+    writeFailed = false;
+    lastSyncMs = halMillis();
+    snprintf(current, sizeof(current), "%s", name);
+    return true;
+}
+
+bool slotBusy()
+{
+    return writeFile >= 0;
+}
+
+bool slotPlayOpen(const char *name)
+{
+    if (readFile >= 0)
+    {
+        halFileClose(readFile);
+        readFile = -1;
+    }
+    int f = openSlot(name, "r");
+    if (f < 0)
+        return false;
+    readRing.reset();
+    readEnd.store(false, std::memory_order_relaxed);
+    readFile = f;
+    snprintf(current, sizeof(current), "%s", name);
+    fillReadAhead();
+    return true;
+}
+
+bool slotRemove(const char *name)
+{
+    if (!slotNameValid(name) || (slotBusy() && strcmp(name, current) == 0))
+        return false;
+    char path[48];
+    slotPath(name, path, sizeof(path));
+    return halFileRemove(path);
+}
+
+struct SlotListCtx
+{
+    void (*onSlot)(const char *name, uint32_t bytes, void *ctx);
+    void *ctx;
+};
+
+static void listFile(const char *name, uint32_t size, void *ctx)
+{
+    const SlotListCtx *list = (const SlotListCtx *)ctx;
+    size_t n = strlen(name), ext = strlen(SLOT_EXT);
+    if (n <= ext || strcmp(name + n - ext, SLOT_EXT) != 0 || n - ext > (size_t)SLOT_NAME_MAX)
+        return;
+    char slot[SLOT_NAME_MAX + 1];
+    snprintf(slot, sizeof(slot), "%.*s", (int)(n - ext), name);
+    list->onSlot(slot, size > sizeof(SLOT_MAGIC) ? size - sizeof(SLOT_MAGIC) : 0, list->ctx);
+}
+
+void slotList(void (*onSlot)(const char *name, uint32_t bytes, void *ctx), void *ctx)
+{
+    SlotListCtx list = {onSlot, ctx};
+    halFileList(SLOT_DIR, listFile, &list);
+}
+
+int slotOpenRead(const char *name)
+{
+    return openSlot(name, "r");
+}
+
+bool slotDecode(const char *name, void (*onRow)(const RecordedStep &step, uint32_t timeMs, void *ctx), void *ctx)
+{
+    int f = openSlot(name, "r");
+    if (f < 0)
+        return false;
+    slotDecodeFile(f, onRow, ctx);
+    return true;
+}
+
+void slotDecodeFile(int f, void (*onRow)(const RecordedStep &step, uint32_t timeMs, void *ctx), void *ctx)
+{
+    uint8_t buf[256];
+    size_t pos = 0, len = 0;
+    bool eof = false;
+    RecordingDecoder dec;
+    RecordedStep step;
+    for (;;)
+    {
+        if (!dec.inRun() && len - pos < RecordingDecoder::MAX_ROW_BYTES)
+        {
+            memmove(buf, buf + pos, len - pos);
+            len -= pos;
+            pos = 0;
+            while (len < sizeof(buf) && !eof)
+            {
+                int n = halFileRead(f, buf + len, (int)(sizeof(buf) - len));
+                eof = n <= 0;
+                len += n > 0 ? n : 0;
+            }
+            // Zeros end the varints of a cut off row inside buf
+            memset(buf + len, 0, sizeof(buf) - len);
+        }
+        if (!dec.inRun() && pos >= len)
+            break;
+        dec.next(buf, pos, step);
+        if (pos > len)
+            break; // Cut off row
+        onRow(step, dec.timeMs(), ctx);
+    }
+    halFileClose(f);
+}
+
+const char *slotCurrent()
+{
+    return current;
+}
+
+// --- CONTROL TASK ---
+void SlotReader::reset()
+{
+    dec = RecordingDecoder();
+    pos = 0;
+    len = 0;
+    end = false;
+}
+
+bool SlotReader::next(RecordedStep &step)
+{
+    if (!dec.inRun())
+    {
+        if (len - pos < RecordingDecoder::MAX_ROW_BYTES)
+        {
+            // End before the bytes, as in the service
+            bool last = readEnd.load(std::memory_order_acquire);
+            memmove(buf, buf + pos, len - pos);
+            len -= pos;
+            pos = 0;
+            len += readRing.pop(buf + len, sizeof(buf) - len);
+            end = last && readRing.empty();
+            memset(buf + len, 0, sizeof(buf) - len); // As in slotDecodeFile()
+        }
+        if (pos >= len)
+        {
+            if (!end)
+                starved++; // Ring empty, the row is due
+            return false;
+        }
+        if (len - pos < RecordingDecoder::MAX_ROW_BYTES && !end)
+        {
+            starved++;
+            return false;
+        }
+    }
+    dec.next(buf, pos, step);
+    if (pos > len)
+    {
+        pos = len = 0; // Cut off row (power lost mid-take): the end
+        dec = RecordingDecoder();
+        return false;
+    }
+    return true;
+}
+
+void slotRecordStart()
+{
+    slotWriting = true;
+    slotEnding = false;
+    slotTail.clear();
+    slotTailPos = 0;
+}
+
+void slotRecordEnd()
+{
+    if (!slotWriting || slotEnding)
+        return;
+    // All bytes are final now; what the ring can't take waits in slotTail,
+    // so recordingBuffer is free for whatever comes next
+    size_t n = writeRing.push(recordingBuffer.raw(), recordingBuffer.bytes());
+    slotTail.assign(recordingBuffer.raw() + n, recordingBuffer.raw() + recordingBuffer.bytes());
+    slotTailPos = 0;
+    recordingBuffer.spill(recordingBuffer.bytes());
+    slotEnding = true;
+    slotRecordTick();
+}
+
+void slotRecordTick()
+{
+    if (!slotWriting)
+        return;
+    if (!slotEnding)
+    {
+        size_t n = writeRing.push(recordingBuffer.raw(), recordingBuffer.finalBytes());
+        if (n)
+            recordingBuffer.spill(n);
+        return;
+    }
+    slotTailPos += writeRing.push(slotTail.data() + slotTailPos, slotTail.size() - slotTailPos);
+    if (slotTailPos == slotTail.size())
+    {
+        slotWriting = false;
+        slotTail.clear();
+        slotTail.shrink_to_fit();
+        writeDone.store(true, std::memory_order_release);
+    }
+}
@@ -0,0 +1,351 @@
+// Workspace map: evaluates the FK of forwardKinematics() for every joint
+// combination at 1% (101^4 poses) and bins the tool tip into voxels.
+//
+//   pio run -e workspace_map && .pio/build/workspace_map/program [options]
+//     --voxel <cm>     voxel edge length (default 0.5)
+//     --threads <n>    worker threads (default and most: all cores)
+//     --blob <file>    counts + pitch range per voxel (format below)
+//     --header <file>  occupancy bitmap as a C header (flash)
+//
+// Blob: WorkspaceBlobHeader, then uint32 count[n], int16 pitchMin[n],
+// int16 pitchMax[n] (deg), n = nx * ny * nz, x fastest. Empty voxels
+// have pitchMin > pitchMax.
+//
+// The sweep is split into the planar chain (shoulder, elbow, wrist: R, Z,
+// pitch) computed once, and the base rotation applied to it in a flat inner
+// loop over the wrist index that the compiler vectorizes.
+
+#include <atomic>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+#include "kinematics.h"
+#include "fast_math.h"
+
+static const int STEPS = 101; // 0..100 percent
+
+struct WorkspaceBlobHeader
+{
+    char magic[4]; // "PWSM"
+    uint32_t version;
+    int32_t nx, ny, nz;
+    float voxelCm;
+    float originX, originY, originZ; // Corner of voxel 0
+};
+
+struct VoxelGrid
+{
+    int nx, ny, nz;
+    float voxel, x0, y0, z0;
+    size_t size() const { return (size_t)nx * ny * nz; }
+};
+
+// Per-thread accumulators, merged at the end
+struct VoxelAccum
+{
+    std::vector<uint32_t> count;
+    std::vector<int16_t> pitchMin;
+    std::vector<int16_t> pitchMax;
+    float minX = 1e9f, maxX = -1e9f, minY = 1e9f, maxY = -1e9f, minZ = 1e9f, maxZ = -1e9f;
+
+    void init(size_t n)
+    {
+        count.assign(n, 0);
+        pitchMin.assign(n, INT16_MAX);
+        pitchMax.assign(n, INT16_MIN);
+    }
+};
+
+// --- PLANAR CHAIN ---
+// Same expressions as forwardKinematics(), indexed [shoulder][elbow][wrist]
+struct PlanarTable
+{
+    std::vector<float> R, Z, pitchDeg;
+};
+
+static void buildPlanar(PlanarTable &t)
+{
+    size_t n = (size_t)STEPS * STEPS * STEPS;
+    t.R.resize(n);
+    t.Z.resize(n);
+    t.pitchDeg.resize(n);
+    for (int s = 0; s < STEPS; s++)
+    {
+        float t2_rad = usToAngle(1, percentToUs(1, s)) * DEG_TO_RAD_F;
+        float s2, c2;
+        fastSinCos(t2_rad, s2, c2);
+        for (int e = 0; e < STEPS; e++)
+        {
+            float gamma_rad = usToAngle(2, percentToUs(2, e)) * DEG_TO_RAD_F;
+            float elbow_global_rad = t2_rad - (PI_F - gamma_rad);
+            float se, ce;
+            fastSinCos(elbow_global_rad, se, ce);
+            size_t row = ((size_t)s * STEPS + e) * STEPS;
+            for (int w = 0; w < STEPS; w++)
+            {
+                float wristServo = usToAngle(3, percentToUs(3, w));
+                float pitch_rad = elbow_global_rad + (wristServo - 180.0f) * DEG_TO_RAD_F;
+                float sp, cp;
+                fastSinCos(pitch_rad, sp, cp);
+                t.R[row + w] = L2 * c2 + L3 * ce + L4 * cp;
+                t.Z[row + w] = L1 + L2 * s2 + L3 * se + L4 * sp;
+                t.pitchDeg[row + w] = pitch_rad * RAD_TO_DEG_F;
+            }
+        }
+    }
+}
+
+// --- SWEEP ---
+static void sweepBase(const PlanarTable &t, const VoxelGrid &g, int b, VoxelAccum &acc)
+{
+    float t1_rad = usToAngle(0, percentToUs(0, b)) * DEG_TO_RAD_F;
+    float s1, c1;
+    fastSinCos(t1_rad, s1, c1);
+
+    const float inv = 1.0f / g.voxel;
+    int32_t idx[STEPS];
+    float xs[STEPS], ys[STEPS];
+    for (size_t row = 0; row < t.R.size(); row += STEPS)
+    {
+        const float *R = &t.R[row];
+        const float *Z = &t.Z[row];
+
+        // Vectorized part: tip position and voxel index for 101 wrist angles
+        for (int w = 0; w < STEPS; w++)
+        {
+            float x = R[w] * c1;
+            float y = R[w] * s1;
+            int ix = (int)((x - g.x0) * inv);
+            int iy = (int)((y - g.y0) * inv);
+            int iz = (int)((Z[w] - g.z0) * inv);
+            idx[w] = (iz * g.ny + iy) * g.nx + ix;
+            xs[w] = x;
+            ys[w] = y;
+        }
+
+        // Scatter into the voxels
+        for (int w = 0; w < STEPS; w++)
+        {
+            size_t v = (size_t)idx[w];
+            int16_t p = (int16_t)lroundf(t.pitchDeg[row + w]);
+            acc.count[v]++;
+            if (p < acc.pitchMin[v])
+                acc.pitchMin[v] = p;
+            if (p > acc.pitchMax[v])
+                acc.pitchMax[v] = p;
+            if (xs[w] < acc.minX)
+                acc.minX = xs[w];
+            if (xs[w] > acc.maxX)
+                acc.maxX = xs[w];
+            if (ys[w] < acc.minY)
+                acc.minY = ys[w];
+            if (ys[w] > acc.maxY)
+                acc.maxY = ys[w];
+            if (Z[w] < acc.minZ)
+                acc.minZ = Z[w];
+            if (Z[w] > acc.maxZ)
+                acc.maxZ = Z[w];
+        }
+    }
+}
+
+// Largest tip distance between the planar table and forwardKinematics()
+static float checkAgainstFK(const PlanarTable &t)
+{
+    float worst = 0.0f;
+    srand(1);
+    for (int i = 0; i < 100000; i++)
+    {
+        int pos[4] = {rand() % STEPS, rand() % STEPS, rand() % STEPS, rand() % STEPS};
+        int us[4];
+        for (int j = 0; j < 4; j++)
+            us[j] = percentToUs(j, pos[j]);
+        Coord ref = forwardKinematics(us);
+        size_t k = ((size_t)pos[1] * STEPS + pos[2]) * STEPS + pos[3];
+        float t1_rad = usToAngle(0, percentToUs(0, pos[0])) * DEG_TO_RAD_F;
+        float s1, c1;
+        fastSinCos(t1_rad, s1, c1);
+        float dx = t.R[k] * c1 - ref.x, dy = t.R[k] * s1 - ref.y, dz = t.Z[k] - ref.z;
+        float d = sqrtf(dx * dx + dy * dy + dz * dz);
+        if (d > worst)
+            worst = d;
+    }
+    return worst;
+}
+
+// --- OUTPUT ---
+static bool writeBlob(const char *path, const VoxelGrid &g, const VoxelAccum &acc)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f)
+        return false;
+    WorkspaceBlobHeader h = {{'P', 'W', 'S', 'M'}, 1, g.nx, g.ny, g.nz, g.voxel, g.x0, g.y0, g.z0};
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+              fwrite(acc.count.data(), sizeof(uint32_t), g.size(), f) == g.size() &&
+              fwrite(acc.pitchMin.data(), sizeof(int16_t), g.size(), f) == g.size() &&
+              fwrite(acc.pitchMax.data(), sizeof(int16_t), g.size(), f) == g.size();
+    return fclose(f) == 0 && ok;
+}
+
+static bool writeHeader(const char *path, const VoxelGrid &g, const VoxelAccum &acc, size_t occupied)
+{
+    FILE *f = fopen(path, "w");
+    if (!f)
+        return false;
+    size_t bytes = (g.size() + 7) / 8;
+    fprintf(f, "// GENERATED by src/tools/workspace_map.cpp - do not edit.\n");
+    fprintf(f, "// L1=%g L2=%g L3=%g L4=%g, %zu/%zu voxels occupied\n", L1, L2, L3, L4, occupied, g.size());
+    fprintf(f, "#ifndef WORKSPACE_MAP_DATA_H\n#define WORKSPACE_MAP_DATA_H\n\n#include <stdint.h>\n\n");
+    fprintf(f, "const float WORKSPACE_VOXEL_CM = %.4ff;\n", g.voxel);
+    fprintf(f, "const float WORKSPACE_X0 = %.4ff;\n", g.x0);
+    fprintf(f, "const float WORKSPACE_Y0 = %.4ff;\n", g.y0);
+    fprintf(f, "const float WORKSPACE_Z0 = %.4ff;\n", g.z0);
+    fprintf(f, "const int WORKSPACE_NX = %d;\n", g.nx);
+    fprintf(f, "const int WORKSPACE_NY = %d;\n", g.ny);
+    fprintf(f, "const int WORKSPACE_NZ = %d;\n\n", g.nz);
+    fprintf(f, "// Occupancy bitmap, bit (z * NY + y) * NX + x. const -> flash (.rodata)\n");
+    fprintf(f, "const uint8_t WORKSPACE_MAP[%zu] = {", bytes);
+    for (size_t i = 0; i < bytes; i++)
+    {
+        uint8_t byte = 0;
+        for (int bit = 0; bit < 8; bit++)
+        {
+            size_t v = i * 8 + bit;
+            if (v < g.size() && acc.count[v])
+                byte |= 1 << bit;
+        }
+        fprintf(f, "%s%u,", i % 32 == 0 ? "\n    " : "", byte);
+    }
+    fprintf(f, "\n};\n\n#endif\n");
+    return fclose(f) == 0;
+}
+
+int main(int argc, char **argv)
+{
+    float voxel = 0.5f;
+    // Every thread has its own full VoxelAccum (~5 MB at 0.5 cm), more
+    // threads than cores only cost memory
+    unsigned cores = std::thread::hardware_concurrency();
+    if (cores < 1)
+        cores = 1;
+    unsigned threads = cores;
+    const char *blobPath = nullptr;
+    const char *headerPath = nullptr;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--voxel") && i + 1 < argc)
+            voxel = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--threads") && i + 1 < argc)
+        {
+            int n = atoi(argv[++i]);
+            threads = n < 1 ? 1 : ((unsigned)n > cores ? cores : (unsigned)n);
+        }
+        else if (!strcmp(argv[i], "--blob") && i + 1 < argc)
+            blobPath = argv[++i];
+        else if (!strcmp(argv[i], "--header") && i + 1 < argc)
+            headerPath = argv[++i];
+        else
+        {
+            printf("usage: %s [--voxel cm] [--threads n] [--blob file] [--header file]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (voxel < 0.05f)
+        voxel = 0.05f;
+
+    // Grid covers the full reach sphere around the shoulder plus one voxel
+    float reach = L2 + L3 + L4 + voxel;
+    VoxelGrid g;
+    g.voxel = voxel;
+    g.nx = g.ny = g.nz = (int)ceilf(2.0f * reach / voxel);
+    g.x0 = g.y0 = -reach;
+    g.z0 = L1 - reach;
+
+    auto start = std::chrono::steady_clock::now();
+    PlanarTable table;
+    buildPlanar(table);
+
+    std::vector<VoxelAccum> accum(threads);
+    std::atomic<int> nextBase(0);
+    std::vector<std::thread> pool;
+    for (unsigned i = 0; i < threads; i++)
+    {
+        pool.emplace_back([&, i]()
+                          {
+                              accum[i].init(g.size());
+                              for (int b = nextBase++; b < STEPS; b = nextBase++)
+                                  sweepBase(table, g, b, accum[i]); });
+    }
+    for (auto &t : pool)
+        t.join();
+
+    // Merge into accum[0]
+    VoxelAccum &total = accum[0];
+    for (unsigned i = 1; i < threads; i++)
+    {
+        const VoxelAccum &a = accum[i];
+        for (size_t v = 0; v < g.size(); v++)
+        {
+            total.count[v] += a.count[v];
+            if (a.pitchMin[v] < total.pitchMin[v])
+                total.pitchMin[v] = a.pitchMin[v];
+            if (a.pitchMax[v] > total.pitchMax[v])
+                total.pitchMax[v] = a.pitchMax[v];
+        }
+        total.minX = fminf(total.minX, a.minX);
+        total.maxX = fmaxf(total.maxX, a.maxX);
+        total.minY = fminf(total.minY, a.minY);
+        total.maxY = fmaxf(total.maxY, a.maxY);
+        total.minZ = fminf(total.minZ, a.minZ);
+        total.maxZ = fmaxf(total.maxZ, a.maxZ);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // --- STATS ---
+    uint64_t poses = 0;
+    size_t occupied = 0, wide = 0;
+    for (size_t v = 0; v < g.size(); v++)
+    {
+        poses += total.count[v];
+        if (total.count[v])
+        {
+            occupied++;
+            // Reachable with at least 90 degrees of pitch freedom
+            if (total.pitchMax[v] - total.pitchMin[v] >= 90)
+                wide++;
+        }
+    }
+    float voxelVolume = voxel * voxel * voxel;
+    printf("poses        %llu (%u threads, %.2f s, %.1f M poses/s)\n", (unsigned long long)poses, threads,
+           seconds, poses / seconds * 1e-6);
+    printf("grid         %d x %d x %d voxels of %.2f cm\n", g.nx, g.ny, g.nz, voxel);
+    printf("occupied     %zu voxels, %.0f cm^3\n", occupied, occupied * voxelVolume);
+    printf("pitch >= 90  %zu voxels, %.0f cm^3\n", wide, wide * voxelVolume);
+    printf("tip bounds   x %.2f..%.2f  y %.2f..%.2f  z %.2f..%.2f cm\n", total.minX, total.maxX, total.minY,
+           total.maxY, total.minZ, total.maxZ);
+    printf("fk check     %.2g cm max deviation from forwardKinematics()\n", checkAgainstFK(table));
+
+    if (blobPath)
+    {
+        if (!writeBlob(blobPath, g, total))
+        {
+            printf("cannot write %s\n", blobPath);
+            return 1;
+        }
+        printf("wrote        %s\n", blobPath);
+    }
+    if (headerPath)
+    {
+        if (!writeHeader(headerPath, g, total, occupied))
+        {
+            printf("cannot write %s\n", headerPath);
+            return 1;
+        }
+        printf("wrote        %s\n", headerPath);
+    }
+    return 0;
+}
@@ -0,0 +1,194 @@
+# Generates include/servo_cal_data.h: a piecewise-linear angle <-> pulse
+# width table per servo, fitted to measured samples.
+#
+#   python tools/fit_servo_cal.py samples.csv [more.csv ...]
+#   python tools/fit_servo_cal.py            (no samples: linear tables)
+#
+# Sample rows are "servo,us,angle": servo index (0-4) or name from
+# servos[], the commanded pulse width and the joint angle measured with the
+# same convention as angle0/angle100 in include/arm_config.h. Lines starting
+# with '#' and non-numeric headers are skipped.
+#
+# Knots are evenly spaced over minUs..maxUs, so usToAngle() finds its
+# segment with one multiply. The knot angles are a least squares fit of the
+# samples with a light second-difference penalty, which keeps knots without
+# nearby samples on a straight line with their neighbours. Servos without
+# samples get the straight angle0/angle100 line. A fit that is not monotonic
+# is rejected, angleToUs() needs the table to be invertible.
+#
+# Re-run tools/gen_ik_grid.py (or just build) afterwards, the IK grid uses
+# the table.
+
+import math
+import os
+import re
+import sys
+
+ROOT = os.path.normpath(os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+CONFIG_H = os.path.join(ROOT, "include", "arm_config.h")
+OUTPUT = os.path.join(ROOT, "include", "servo_cal_data.h")
+
+POINTS = 13
+SMOOTHING = 1e-3  # Weight of the second-difference penalty, per sample
+
+
+def read_servos():
+    with open(CONFIG_H) as f:
+        h = f.read()
+    servos = []
+    for m in re.finditer(r"\{\s*(\d+),\s*(\d+),\s*(\d+),\s*(\d+),\s*([-0-9.]+),\s*([-0-9.]+),\s*\"(\w+)\"[^}]*\}", h):
+        servos.append({"minUs": int(m.group(2)), "maxUs": int(m.group(3)),
+                       "angle0": float(m.group(5)), "angle100": float(m.group(6)), "name": m.group(7)})
+    if len(servos) < 4:
+        raise RuntimeError("could not parse servos[] from " + CONFIG_H)
+    return servos
+
+
+def read_samples(paths, servos):
+    names = {s["name"].lower(): i for i, s in enumerate(servos)}
+    samples = [[] for _ in servos]
+    for path in paths:
+        with open(path) as f:
+            for n, line in enumerate(f, 1):
+                line = line.strip()
+                if not line or line.startswith("#"):
+                    continue
+                cols = [c.strip() for c in line.split(",")]
+                if len(cols) < 3:
+                    continue
+                key = cols[0].lower()
+                idx = int(key) if key.isdigit() else names.get(key)
+                try:
+                    us, angle = float(cols[1]), float(cols[2])
+                except ValueError:
+                    continue  # Header
+                if idx is None or idx >= len(servos):
+                    raise RuntimeError("%s:%d: unknown servo '%s'" % (path, n, cols[0]))
+                samples[idx].append((us, angle))
+    return samples
+
+
+def knots(servo):
+    step = (servo["maxUs"] - servo["minUs"]) / float(POINTS - 1)
+    return [servo["minUs"] + k * step for k in range(POINTS)]
+
+
+def linear(servo):
+    span = servo["maxUs"] - servo["minUs"]
+    return [servo["angle0"] + (u - servo["minUs"]) * (servo["angle100"] - servo["angle0"]) / span
+            for u in knots(servo)]
+
+
+def basis(servo, us):
+    # Hat functions of the knots: (segment, weight of its left knot).
+    # Outside the range the end segment is extended.
+    step = (servo["maxUs"] - servo["minUs"]) / float(POINTS - 1)
+    t = (us - servo["minUs"]) / step
+    k = min(max(int(math.floor(t)), 0), POINTS - 2)
+    f = t - k
+    return k, 1.0 - f
+
+
+def solve(a, b):
+    # Gaussian elimination with partial pivoting, a is small and dense
+    n = len(b)
+    for c in range(n):
+        p = max(range(c, n), key=lambda r: abs(a[r][c]))
+        a[c], a[p] = a[p], a[c]
+        b[c], b[p] = b[p], b[c]
+        for r in range(c + 1, n):
+            m = a[r][c] / a[c][c]
+            for k in range(c, n):
+                a[r][k] -= m * a[c][k]
+            b[r] -= m * b[c]
+    x = [0.0] * n
+    for r in range(n - 1, -1, -1):
+        x[r] = (b[r] - sum(a[r][k] * x[k] for k in range(r + 1, n))) / a[r][r]
+    return x
+
+
+def fit(servo, samples):
+    n = POINTS
+    a = [[0.0] * n for _ in range(n)]
+    b = [0.0] * n
+    for us, angle in samples:
+        k, w = basis(servo, us)
+        for i, wi in ((k, w), (k + 1, 1.0 - w)):
+            b[i] += wi * angle
+            for j, wj in ((k, w), (k + 1, 1.0 - w)):
+                a[i][j] += wi * wj
+    lam = SMOOTHING * len(samples)
+    for k in range(1, n - 1):
+        d = {k - 1: 1.0, k: -2.0, k + 1: 1.0}
+        for i, di in d.items():
+            for j, dj in d.items():
+                a[i][j] += lam * di * dj
+    return solve(a, b)
+
+
+def evaluate(servo, table, us):
+    k, w = basis(servo, us)
+    return table[k] * w + table[k + 1] * (1.0 - w)
+
+
+def generate(paths):
+    servos = read_servos()
+    samples = read_samples(paths, servos)
+    tables = []
+    notes = []
+    for i, servo in enumerate(servos):
+        pts = samples[i]
+        lin = linear(servo)
+        if len(set(round(u) for u, _ in pts)) < 2:
+            tables.append(lin)
+            notes.append("%s: linear (angle0/angle100)" % servo["name"])
+            continue
+        table = fit(servo, pts)
+        steps = [table[k + 1] - table[k] for k in range(POINTS - 1)]
+        if not (all(s > 0 for s in steps) or all(s < 0 for s in steps)):
+            raise RuntimeError("%s: fitted table is not monotonic, check the samples" % servo["name"])
+        res = [evaluate(servo, table, u) - ang for u, ang in pts]
+        rms = math.sqrt(sum(r * r for r in res) / len(res))
+        worst = max(abs(r) for r in res)
+        bend = max(abs(t - l) for t, l in zip(table, lin))
+        tables.append(table)
+        notes.append("%s: %d samples, rms %.2f deg, max %.2f deg, up to %.1f deg off linear"
+                     % (servo["name"], len(pts), rms, worst, bend))
+
+    out = []
+    out.append("// GENERATED by tools/fit_servo_cal.py - do not edit.")
+    for note in notes:
+        out.append("// " + note)
+    out.append("#ifndef SERVO_CAL_DATA_H")
+    out.append("#define SERVO_CAL_DATA_H")
+    out.append("")
+    out.append("constexpr int SERVO_CAL_SERVOS = %d;" % len(servos))
+    out.append("constexpr int SERVO_CAL_POINTS = %d;" % POINTS)
+    out.append("")
+    out.append("// Knots are evenly spaced from SERVO_CAL_MIN_US to SERVO_CAL_MAX_US")
+    out.append("constexpr int SERVO_CAL_MIN_US[%d] = {%s};" % (len(servos), ", ".join(str(s["minUs"]) for s in servos)))
+    out.append("constexpr int SERVO_CAL_MAX_US[%d] = {%s};" % (len(servos), ", ".join(str(s["maxUs"]) for s in servos)))
+    out.append("")
+    out.append("// Joint angle (deg) at every knot. constexpr -> flash (.rodata)")
+    out.append("constexpr float SERVO_CAL_ANGLE[%d][%d] = {" % (len(servos), POINTS))
+    for servo, table in zip(servos, tables):
+        out.append("    {%s}, // %s" % (", ".join("%.4ff" % v for v in table), servo["name"]))
+    out.append("};")
+    out.append("")
+    out.append("#endif")
+    text = "\n".join(out) + "\n"
+
+    old = None
+    if os.path.exists(OUTPUT):
+        with open(OUTPUT) as f:
+            old = f.read()
+    if old != text:
+        with open(OUTPUT, "w") as f:
+            f.write(text)
+    print("fit_servo_cal: %s" % OUTPUT)
+    for note in notes:
+        print("  " + note)
+
+
+if __name__ == "__main__":
+    generate(sys.argv[1:])
@@ -0,0 +1,195 @@
+# Generates include/ik_grid_data.h: a reachability + IK seed grid over the
+# arm's workspace, computed from L1-L4, the servos[] table and the servo
+# calibration in include/servo_cal_data.h.
+#
+# Runs as a PlatformIO pre-build script (see platformio.ini) and can also be
+# called by hand:  python tools/gen_ik_grid.py
+# The header is only rewritten when its content changes.
+#
+# The grid is 3D over (R, Z, pitch) - the workspace is symmetric around the
+# base axis, the base angle is checked separately at lookup time. R is the
+# signed distance in the arm plane: R < 0 is the base turned 180 deg, reaching
+# over the top, so one axis holds both base branches of inverseKinematics().
+# Each node stores shoulder/elbow/wrist in microseconds, elbow up if it is
+# inside the servo ranges, else elbow down (flagged on the elbow entry), in
+# the order inverseKinematics() tries them. 0 marks an unreachable node.
+# The IK below mirrors solveElbows()/angleToUsInRange() in src/kinematics.cpp.
+
+import math
+import os
+import re
+
+try:
+    Import("env")  # noqa: F821 (PlatformIO)
+    ROOT = env.subst("$PROJECT_DIR")  # noqa: F821
+except NameError:
+    ROOT = os.path.normpath(os.path.join(os.path.dirname(os.path.abspath(__file__)), ".."))
+
+CONFIG_H = os.path.join(ROOT, "include", "arm_config.h")
+CAL_H = os.path.join(ROOT, "include", "servo_cal_data.h")
+OUTPUT = os.path.join(ROOT, "include", "ik_grid_data.h")
+
+# Grid layout: min, step, count
+R_AXIS = (-22.0, 1.0, 45)   # cm, -22..22, signed (see above)
+Z_AXIS = (-14.0, 1.0, 44)   # cm, -14..29
+P_AXIS = (-90.0, 10.0, 19)  # deg, -90..90
+
+UNREACHABLE = 0
+ELBOW_DOWN = 0x8000
+
+
+def read_config():
+    with open(CONFIG_H) as f:
+        h = f.read()
+    lengths = {}
+    for name in ("L1", "L2", "L3", "L4"):
+        m = re.search(r"const float %s = ([-0-9.]+);" % name, h)
+        lengths[name] = float(m.group(1))
+
+    servos = []
+    for m in re.finditer(r"\{\s*(\d+),\s*(\d+),\s*(\d+),\s*(\d+),\s*([-0-9.]+),\s*([-0-9.]+),\s*\"(\w+)\"[^}]*\}", h):
+        servos.append({"minUs": int(m.group(2)), "maxUs": int(m.group(3)),
+                       "angle0": float(m.group(5)), "angle100": float(m.group(6)), "name": m.group(7)})
+    if len(servos) < 4:
+        raise RuntimeError("could not parse servos[] from " + CONFIG_H)
+    read_calibration(servos)
+    return lengths, servos
+
+
+def read_calibration(servos):
+    # Knot angles from servo_cal_data.h (tools/fit_servo_cal.py), if present
+    if not os.path.exists(CAL_H):
+        return
+    with open(CAL_H) as f:
+        h = f.read()
+    lo = [int(v) for v in re.search(r"SERVO_CAL_MIN_US\[\d+\] = \{([^}]*)\}", h).group(1).split(",")]
+    hi = [int(v) for v in re.search(r"SERVO_CAL_MAX_US\[\d+\] = \{([^}]*)\}", h).group(1).split(",")]
+    rows = re.findall(r"^\s*\{([-0-9.f, ]+)\},", h, re.M)
+    for i, servo in enumerate(servos[:len(rows)]):
+        servo["cal"] = (lo[i], hi[i], [float(v.strip().rstrip("f")) for v in rows[i].split(",")])
+
+
+def angle_to_us(servo, angle):
+    # Mirrors angleToUs() in src/kinematics.cpp, end segments extended
+    if "cal" not in servo:
+        return servo["minUs"] + (angle - servo["angle0"]) * (servo["maxUs"] - servo["minUs"]) / (
+            servo["angle100"] - servo["angle0"])
+    lo, hi, a = servo["cal"]
+    step = (hi - lo) / float(len(a) - 1)
+    rising = a[-1] >= a[0]
+    k = 0
+    while k < len(a) - 2 and (angle > a[k + 1] if rising else angle < a[k + 1]):
+        k += 1
+    if a[k + 1] == a[k]:
+        return lo + k * step
+    return lo + k * step + (angle - a[k]) * step / (a[k + 1] - a[k])
+
+
+def us_in_range(servo, angle):
+    # Mirrors angleToUsInRange(): tries +/-360 deg wraps, None if none fits
+    for wrap in (0.0, 360.0, -360.0):
+        us = angle_to_us(servo, angle + wrap)
+        if servo["minUs"] - 0.02 <= us <= servo["maxUs"] + 0.02:
+            return min(max(us, servo["minUs"]), servo["maxUs"])
+    return None
+
+
+def solve(lengths, servos, R, z, pitch_deg):
+    L1, L2, L3, L4 = lengths["L1"], lengths["L2"], lengths["L3"], lengths["L4"]
+    pitch = math.radians(pitch_deg)
+    wr = R - L4 * math.cos(pitch)
+    wz = (z - L1) - L4 * math.sin(pitch)
+    d_sq = wr * wr + wz * wz
+    d = math.sqrt(d_sq)
+    if d > L2 + L3 or d < abs(L2 - L3) or d < 1e-6:
+        return None
+
+    alpha = math.acos(max(-1.0, min(1.0, (d_sq + L2 * L2 - L3 * L3) / (2 * d * L2))))
+    phi = math.atan2(wz, wr)
+    gamma = math.acos(max(-1.0, min(1.0, (L2 * L2 + L3 * L3 - d_sq) / (2 * L2 * L3))))
+    for down in (False, True):
+        theta2 = phi - alpha if down else phi + alpha
+        elbow = 2 * math.pi - gamma if down else gamma
+        elbow_global = theta2 - (math.pi - elbow)
+        wrist = pitch - elbow_global + math.pi
+        joints = [us_in_range(servos[1], math.degrees(theta2)),
+                  us_in_range(servos[2], math.degrees(elbow)),
+                  us_in_range(servos[3], math.degrees(wrist))]
+        if None not in joints:
+            joints = [int(round(us)) for us in joints]
+            if down:
+                joints[1] |= ELBOW_DOWN
+            return joints
+    return None
+
+
+def solve_node(lengths, servos, R, z, pitch_deg):
+    # inverseKinematics() keeps R >= 0.1 away from the base axis; the node on
+    # the axis serves both sides, so it needs both
+    if R != 0.0:
+        return solve(lengths, servos, R, z, pitch_deg)
+    a = solve(lengths, servos, 0.1, z, pitch_deg)
+    b = solve(lengths, servos, -0.1, z, pitch_deg)
+    return a if a is not None and b is not None else None
+
+
+def generate():
+    lengths, servos = read_config()
+    cells = []
+    reachable = 0
+    for ip in range(P_AXIS[2]):
+        pitch = P_AXIS[0] + ip * P_AXIS[1]
+        for iz in range(Z_AXIS[2]):
+            z = Z_AXIS[0] + iz * Z_AXIS[1]
+            for ir in range(R_AXIS[2]):
+                r = R_AXIS[0] + ir * R_AXIS[1]
+                sol = solve_node(lengths, servos, r, z, pitch)
+                if sol is None:
+                    cells.extend([UNREACHABLE] * 3)
+                else:
+                    cells.extend(sol)
+                    reachable += 1
+
+    nodes = R_AXIS[2] * Z_AXIS[2] * P_AXIS[2]
+    out = []
+    out.append("// GENERATED by tools/gen_ik_grid.py - do not edit.")
+    out.append("// L1=%g L2=%g L3=%g L4=%g, %d/%d nodes reachable"
+               % (lengths["L1"], lengths["L2"], lengths["L3"], lengths["L4"], reachable, nodes))
+    out.append("#ifndef IK_GRID_DATA_H")
+    out.append("#define IK_GRID_DATA_H")
+    out.append("")
+    out.append("#include <stdint.h>")
+    out.append("")
+    out.append("const float IK_GRID_R_MIN = %.1ff;" % R_AXIS[0])
+    out.append("const float IK_GRID_R_STEP = %.1ff;" % R_AXIS[1])
+    out.append("const int IK_GRID_R_COUNT = %d;" % R_AXIS[2])
+    out.append("const float IK_GRID_Z_MIN = %.1ff;" % Z_AXIS[0])
+    out.append("const float IK_GRID_Z_STEP = %.1ff;" % Z_AXIS[1])
+    out.append("const int IK_GRID_Z_COUNT = %d;" % Z_AXIS[2])
+    out.append("const float IK_GRID_P_MIN = %.1ff;" % P_AXIS[0])
+    out.append("const float IK_GRID_P_STEP = %.1ff;" % P_AXIS[1])
+    out.append("const int IK_GRID_P_COUNT = %d;" % P_AXIS[2])
+    out.append("const uint16_t IK_GRID_UNREACHABLE = %d;" % UNREACHABLE)
+    out.append("const uint16_t IK_GRID_ELBOW_DOWN = 0x%04X; // On the elbow entry" % ELBOW_DOWN)
+    out.append("")
+    out.append("// [pitch][z][r][shoulder, elbow, wrist], us. const -> flash (.rodata)")
+    out.append("const uint16_t IK_GRID[%d] = {" % len(cells))
+    row = R_AXIS[2] * 3
+    for i in range(0, len(cells), row):
+        out.append("    " + ",".join(str(v) for v in cells[i:i + row]) + ",")
+    out.append("};")
+    out.append("")
+    out.append("#endif")
+    text = "\n".join(out) + "\n"
+
+    old = None
+    if os.path.exists(OUTPUT):
+        with open(OUTPUT) as f:
+            old = f.read()
+    if old != text:
+        with open(OUTPUT, "w") as f:
+            f.write(text)
+        print("gen_ik_grid: wrote %s (%d/%d nodes reachable)" % (OUTPUT, reachable, nodes))
+
+
+generate()